@@ -0,0 +1,80 @@
+//=====================================================================================================================================================
+// Machines under test, one channel each
+//=====================================================================================================================================================
+// A channel holds the lines of one machine and the state of the sequences running on it: several machines are tested
+// at once by running the same sequence table on each channel in turn. Channel 0 is wired to the Uno pins and keeps
+// the checks timed by the interrupts (edge capture, round trip, wave capture, input trace); the other channels are on
+// the I/O expander, their lines are polled at the input sampling period. Build with -DCHANNEL_COUNT=n for n machines.
+//=====================================================================================================================================================
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include "Hal.h"
+#include "IoExpander.h"
+#include "Journal.h"
+#include "Scheduler.h"
+#include "SequenceTable.h"
+
+#ifndef CHANNEL_COUNT
+#define CHANNEL_COUNT 1                           // Machines tested at once, channel 0 on the Uno pins
+#endif
+
+static_assert(CHANNEL_COUNT >= 1 && CHANNEL_COUNT <= 1 + EXPANDER_SLOTS, "CHANNEL_COUNT must be 1 to 1 + EXPANDER_SLOTS");
+
+// Passive sequences run as a group, one lane per sequence: the lanes share the step index, the countdown and the
+// confirmation. Any other sequence runs alone, in lane 0.
+const uint8_t LANE_MAX = 2;                       // Sequences run together, one row each on the group summary
+
+struct SequenceLane {
+  uint8_t sequence;                               // SequenceState run in this lane
+  StepDescriptor step;                            // RAM copy of its running step
+  uint8_t verdict;                                // Verdict, sent over the telemetry when the sequence ends
+  bool settling;                                  // The input of the step is at its expected level
+  unsigned long settleStart;                      // millis() when it reached that level
+  unsigned long settleTime;                       // Time the input took to settle in the sequence, in ms
+};
+
+struct InputState {
+  uint8_t emergency;                              // Last level read on the pin_Emergency line
+  uint8_t wallSwitch;                             // Last level read on the pin_Wall_switch line
+  uint8_t start;                                  // Last level read on the pin_Start line
+  uint8_t shutdownRequest;                        // Last level read on the pin_Shutdown_request line
+  uint8_t button;                                 // Debounced level of button_next_sequence, shared by the channels
+};
+
+struct Channel {
+  uint8_t index;                                  // 0 on the Uno pins, 1 + expander slot for the others
+  uint8_t sequence;                               // Current sequence (first lane of the group)
+  uint8_t stepIndex;                              // Index of the running step inside the current sequences
+  SequenceLane lanes[LANE_MAX];                   // Sequences running, lanes[0] is the current sequence
+  uint8_t laneCount;
+  Timer stepTimer;                                // Countdowns and timed messages of the current step
+  unsigned long sequenceStartTime;                // millis() when the current sequences started
+  InputState inputs;                              // Sampled by task_sampleInputs(), read by the sequences
+  bool buttonPressed;                             // Set on a press or a remote confirmation, cleared when consumed
+  bool roundTripTimed;                            // The current sequence drove a timed shutdown command
+  uint8_t screen;                                 // ScreenId requested by the current step
+  unsigned long countdownValue;                   // Seconds displayed by the countdown screens
+  JournalRecord cycleRecord;                      // Filled by each sequence, journaled at the end of sequence 5
+};
+
+// Sets the channel number and the idle state, before its first sequence
+void channel_begin(Channel& channel, uint8_t index);
+
+// Copies the debounced levels of its lines into channel.inputs, after expander_update() for the expander channels
+void channel_sampleInputs(Channel& channel);
+
+// Last sampled level of an input used by the sequence table, the lines are named by their pin on channel 0
+uint8_t channel_inputLevel(const Channel& channel, uint8_t pin);
+
+// Drives an output used by the sequence table, and reads back its level
+void channel_writeOutput(const Channel& channel, uint8_t pin, uint8_t level);
+uint8_t channel_outputLevel(const Channel& channel, uint8_t pin);
+
+// The checks timed by the interrupts only run on the Uno pins
+inline bool channel_timed(const Channel& channel) {
+  return channel.index == 0;
+}
+//=====================================================================================================================================================
+
+#endif
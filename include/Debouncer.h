@@ -0,0 +1,32 @@
+//=====================================================================================================================================================
+// Timer-interrupt debouncer of the inputs on port D
+//=====================================================================================================================================================
+// Timer2 samples PIND in one read every millisecond and runs a 2-bit vertical counter per pin: a pin changes its
+// debounced level after DEBOUNCER_SAMPLES consecutive samples at the new level. The main loop reads the debounced
+// levels and the press / release events accumulated since its last call, so a press is seen within a few ms.
+//=====================================================================================================================================================
+#ifndef DEBOUNCER_H
+#define DEBOUNCER_H
+
+#include "Hal.h"
+
+const uint16_t DEBOUNCER_SAMPLE_PERIOD_US = 1000; // Sampling period: 1 kHz
+const uint8_t DEBOUNCER_SAMPLES = 4;              // Consecutive samples needed to accept a new level (fixed by the counters)
+
+// Starts the sampling interrupt, the debounced levels start at the current levels of the pins
+void debouncer_begin();
+
+// Debounced level of an Arduino pin of port D (0 to 7)
+uint8_t debouncer_level(uint8_t pin);
+
+// Pins that went LOW (pressed) or HIGH (released) since the previous call, one bit per pin of port D
+uint8_t debouncer_takePresses();
+uint8_t debouncer_takeReleases();
+
+// Bit of an Arduino pin in the port D masks
+inline uint8_t debouncer_mask(uint8_t pin) {
+  return 1 << pin;
+}
+//=====================================================================================================================================================
+
+#endif
@@ -0,0 +1,56 @@
+//=====================================================================================================================================================
+// Interrupt-driven edge capture for the E-stop (INT0) and wall-switch (INT1) inputs
+//=====================================================================================================================================================
+// Every transition is timestamped with micros() inside the interrupt and pushed into a lock-free ring buffer.
+// The interrupt is the only producer and the main loop the only consumer, so the two indexes never need a lock.
+//=====================================================================================================================================================
+#ifndef EDGE_CAPTURE_H
+#define EDGE_CAPTURE_H
+
+#include "Hal.h"
+
+const uint8_t EDGE_BUFFER_SIZE = 32;              // Number of edges the ring buffer can hold (power of two)
+const unsigned long EDGE_BURST_GAP_US = 20000;    // Edges closer than 20 ms belong to the same transition (contact bounce)
+
+enum EdgeChannel {
+  EDGE_EMERGENCY,                                 // pin_Emergency on INT0
+  EDGE_WALL_SWITCH,                               // pin_Wall_switch on INT1
+  EDGE_CHANNEL_COUNT
+};
+
+struct EdgeEvent {
+  unsigned long timestamp;                        // micros() when the interrupt fired
+  uint8_t channel;                                // EdgeChannel of the input
+  uint8_t level;                                  // Level read right after the edge
+};
+
+// Attaches the CHANGE interrupts of pin_Emergency and pin_Wall_switch, the only pins wired to INT0 / INT1
+void edgeCapture_begin();
+
+// Removes the oldest captured edge, returns false when the buffer is empty
+bool edgeCapture_pop(EdgeEvent& event);
+
+// Number of edges dropped because the buffer was full
+uint8_t edgeCapture_overflows();
+
+
+
+//=====================================================================================================================================================
+// Timing statistics of one input, built from its captured edges
+//=====================================================================================================================================================
+struct EdgeStats {
+  unsigned long reference;                        // micros() when the measurement started (start of the check)
+  unsigned long burstStart;                       // micros() of the first edge of the last transition
+  unsigned long burstEnd;                         // micros() of the last edge of the last transition
+  uint8_t edges;                                  // Total number of edges since the reset
+  uint8_t bounces;                                // Extra edges inside the last transition
+};
+
+void edgeStats_reset(EdgeStats& stats, unsigned long reference);
+void edgeStats_add(EdgeStats& stats, const EdgeEvent& event);
+
+unsigned long edgeStats_responseTime(const EdgeStats& stats);   // From the reference to the first edge of the last transition, in us
+unsigned long edgeStats_settleTime(const EdgeStats& stats);     // From the first to the last edge of the last transition, in us
+//=====================================================================================================================================================
+
+#endif
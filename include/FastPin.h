@@ -0,0 +1,61 @@
+//=====================================================================================================================================================
+// Compile-time pin access
+//=====================================================================================================================================================
+// FastPin<pin> resolves the port register and bit of an Arduino pin number at compile time. On the Uno every call
+// inlines to a single SBI / CBI / SBIS instruction on PORTx, DDRx or PINx instead of the table lookups and the PWM
+// check of digitalRead() / digitalWrite(). Single-bit SBI / CBI are atomic, the pins can be used from the interrupts.
+// The native build forwards to the simulated pins of the HAL.
+//=====================================================================================================================================================
+#ifndef FAST_PIN_H
+#define FAST_PIN_H
+
+#include "Hal.h"
+
+template <uint8_t PIN>
+struct FastPin {
+  static_assert(PIN < 20, "FastPin needs a digital pin D0..D13 or A0..A5");
+
+#ifdef ARDUINO
+  // D0..D7 are PD0..PD7, D8..D13 are PB0..PB5 and A0..A5 are PC0..PC5
+  static const uint8_t BIT = PIN < 8 ? PIN : PIN < 14 ? PIN - 8 : PIN - 14;
+  static const uint8_t MASK = 1 << BIT;
+
+  static volatile uint8_t& port() { return PIN < 8 ? PORTD : PIN < 14 ? PORTB : PORTC; }
+  static volatile uint8_t& ddr() { return PIN < 8 ? DDRD : PIN < 14 ? DDRB : DDRC; }
+  static volatile uint8_t& pin() { return PIN < 8 ? PIND : PIN < 14 ? PINB : PINC; }
+
+  static uint8_t read() { return (pin() & MASK) ? HIGH : LOW; }
+  static void high() { port() |= MASK; }
+  static void low() { port() &= ~MASK; }
+  static void write(uint8_t level) {
+    if (level == LOW) {
+      low();
+    } else {
+      high();
+    }
+  }
+
+  static void setMode(uint8_t mode) {
+    if (mode == OUTPUT) {
+      ddr() |= MASK;
+    } else {
+      ddr() &= ~MASK;
+      // The PORT bit of an input enables its pull-up
+      if (mode == INPUT_PULLUP) {
+        high();
+      } else {
+        low();
+      }
+    }
+  }
+#else
+  static uint8_t read() { return hal_digitalRead(PIN); }
+  static void high() { hal_digitalWrite(PIN, HIGH); }
+  static void low() { hal_digitalWrite(PIN, LOW); }
+  static void write(uint8_t level) { hal_digitalWrite(PIN, level); }
+  static void setMode(uint8_t mode) { hal_pinMode(PIN, mode); }
+#endif
+};
+//=====================================================================================================================================================
+
+#endif
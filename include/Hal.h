@@ -0,0 +1,41 @@
+//=====================================================================================================================================================
+// Hardware abstraction layer
+//=====================================================================================================================================================
+// The firmware only talks to the pins and the clock through these functions. On the Uno they map directly to the
+// Arduino core; the native build (pio test -e native) links them to the simulated pins and virtual clock of
+// HalNative.cpp. The drivers that own a peripheral (LcdI2c, Uart, ...) have their own native backend.
+//=====================================================================================================================================================
+#ifndef HAL_H
+#define HAL_H
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+
+inline uint8_t hal_digitalRead(uint8_t pin) { return digitalRead(pin); }
+inline void hal_digitalWrite(uint8_t pin, uint8_t level) { digitalWrite(pin, level); }
+inline void hal_pinMode(uint8_t pin, uint8_t mode) { pinMode(pin, mode); }
+inline unsigned long hal_millis() { return millis(); }
+inline unsigned long hal_micros() { return micros(); }
+inline void hal_delay(unsigned long milliseconds) { delay(milliseconds); }
+
+// Calls the function on every edge of the pin, the pin must be INT0 (D2) or INT1 (D3)
+inline void hal_attachChangeInterrupt(uint8_t pin, void (*isr)()) {
+  attachInterrupt(digitalPinToInterrupt(pin), isr, CHANGE);
+}
+
+// Critical section around data shared with an interrupt
+inline uint8_t hal_disableInterrupts() {
+  uint8_t status = SREG;
+  cli();
+  return status;
+}
+inline void hal_restoreInterrupts(uint8_t status) { SREG = status; }
+
+#else
+
+#include "HalNative.h"
+
+#endif
+
+#endif
@@ -0,0 +1,91 @@
+//=====================================================================================================================================================
+// Native (host) backend of the hardware abstraction layer
+//=====================================================================================================================================================
+// Provides the small part of the Arduino API the firmware uses, simulated pins with their interrupts, a virtual
+// clock that only moves when a test advances it, and the I2C LCD backpack with a 20x4 HD44780 kept in memory. Only compiled when ARDUINO is not
+// defined, through Hal.h.
+//=====================================================================================================================================================
+#ifndef HAL_NATIVE_H
+#define HAL_NATIVE_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+// Flash access: the host has a single address space
+#define PROGMEM
+#define pgm_read_byte(address) (*(const uint8_t*)(address))
+#define pgm_read_ptr(address) (*(const void* const*)(address))
+#define memcpy_P memcpy
+#define vsnprintf_P vsnprintf
+
+const uint8_t SIM_PIN_COUNT = 20;                 // D0..D13 and A0..A5
+const uint8_t SIM_TIMER_COUNT = 6;                // Periodic interrupts the simulation can run
+const uint8_t SIM_LCD_I2C_ADDRESS = 0x27;         // Address the simulated PCF8574 backpack answers
+const unsigned long SIM_I2C_BYTE_US = 90;         // 8 data bits and the acknowledge at 100 kHz
+
+
+
+//=====================================================================================================================================================
+// Minimal Print class, same interface as the Arduino core for what the firmware uses
+//=====================================================================================================================================================
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t character) = 0;
+  size_t write(const uint8_t* buffer, size_t size);
+  size_t print(const char* text);
+  size_t print(char character);
+  size_t print(unsigned long value);
+};
+
+
+
+//=====================================================================================================================================================
+// HAL functions
+//=====================================================================================================================================================
+uint8_t hal_digitalRead(uint8_t pin);
+void hal_digitalWrite(uint8_t pin, uint8_t level);
+void hal_pinMode(uint8_t pin, uint8_t mode);
+unsigned long hal_millis();
+unsigned long hal_micros();
+void hal_delay(unsigned long milliseconds);
+void hal_attachChangeInterrupt(uint8_t pin, void (*isr)());
+inline uint8_t hal_disableInterrupts() { return 0; }       // The simulated interrupts only run inside sim_ calls
+inline void hal_restoreInterrupts(uint8_t) {}
+
+
+
+//=====================================================================================================================================================
+// Simulation control, used by the native tests
+//=====================================================================================================================================================
+void sim_reset();                                 // All pins HIGH (pull-ups), clock at 0, LCD blank, counters cleared
+void sim_setPin(uint8_t pin, uint8_t level);      // Drives an input, runs its interrupt on a change
+void sim_attachPortChangeInterrupt(void (*isr)());  // Runs on a change of D0..D7, after the pin's own interrupt
+uint8_t sim_pin(uint8_t pin);                     // Current level of a pin, inputs and outputs
+void sim_advanceMicros(unsigned long microseconds); // Moves the virtual clock, running the timer interrupts that fall due
+void sim_attachTimerInterrupt(unsigned long periodMicros, void (*isr)());  // Periodic interrupt, like a hardware timer
+void sim_detachTimerInterrupt(void (*isr)());     // Stops it, can be called from the interrupt itself
+uint8_t sim_timerInterrupts();                    // Timer interrupts attached
+void sim_attachWakeHook(void (*hook)());          // Runs before each timer and pin interrupt, like the wake-up from sleep
+bool sim_i2cStart(uint8_t address);               // I2C bus seen by the TWI driver, false when no device acknowledges
+void sim_i2cSetAcknowledge(bool acknowledge);     // false: the backpack no longer answers, like a loose connector
+void sim_i2cWrite(uint8_t data);
+void sim_i2cStop();
+const char* sim_lcdRow(uint8_t row);              // Content of one LCD row, 20 characters
+unsigned long sim_lcdBytes();                     // Characters and commands sent to the LCD since sim_reset()
+unsigned long sim_i2cTransactions();              // I2C transactions those bytes needed
+unsigned long sim_i2cBytes();                     // I2C data bytes those transactions carried
+void sim_enableBusTiming(bool enabled);           // I2C bytes take their bus time on the virtual clock, off by default
+bool sim_busTimingEnabled();                      // Otherwise a transaction completes as soon as it starts
+//=====================================================================================================================================================
+
+#endif
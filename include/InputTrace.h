@@ -0,0 +1,49 @@
+//=====================================================================================================================================================
+// Recording of the input transitions, for replaying a field session on the native build
+//=====================================================================================================================================================
+// While recording, the port D pin-change interrupt timestamps every change of the five inputs of the box and pushes
+// the new levels into a ring buffer that the main loop sends over the telemetry. tools/telemetry_decode.py writes the
+// transitions to a trace file that test/test_native_replay plays back into the firmware under the virtual clock.
+//=====================================================================================================================================================
+#ifndef INPUT_TRACE_H
+#define INPUT_TRACE_H
+
+#include "Hal.h"
+#include "Pins.h"
+
+const uint8_t INPUT_TRACE_PINS = (1 << pin_Emergency) | (1 << pin_Wall_switch) | (1 << pin_Start) |
+                                 (1 << pin_Shutdown_request) | (1 << button_next_sequence);   // Recorded pins, bit n = Dn
+const uint8_t INPUT_TRACE_PIN_COUNT = 5;
+static_assert(__builtin_popcount(INPUT_TRACE_PINS) == INPUT_TRACE_PIN_COUNT, "INPUT_TRACE_PIN_COUNT must match INPUT_TRACE_PINS");
+const uint8_t INPUT_TRACE_BOUNCE_EDGES = 8;       // Edges of a bouncing field contact within its 5 ms bounce window
+// A bounce burst on every recorded input at once: task_serviceSerial() only empties the ring every 5 ms, the length
+// of the burst. One slot stays empty, it tells a full ring from an empty one
+const uint8_t INPUT_TRACE_BUFFER_SIZE = INPUT_TRACE_PIN_COUNT * INPUT_TRACE_BOUNCE_EDGES + 1;
+
+struct InputTransition {
+  unsigned long time;                             // micros() since the start of the recording
+  uint8_t levels;                                 // Levels of the recorded pins after the change, bit n = pin Dn
+};
+
+// Starts a recording from the current levels, dropping the transitions of a previous one not sent yet
+void inputTrace_start();
+
+// Stops recording, the transitions already captured can still be taken
+void inputTrace_stop();
+
+bool inputTrace_recording();
+unsigned long inputTrace_startTime();             // micros() when the recording started
+uint8_t inputTrace_startLevels();                 // Levels of the recorded pins at that time
+
+// Removes the oldest captured transition, returns false when the buffer is empty
+bool inputTrace_take(InputTransition& transition);
+bool inputTrace_pending();                        // Transitions are waiting to be taken
+
+uint16_t inputTrace_transitions();                // Transitions captured since the start, sent or not
+uint8_t inputTrace_overflows();                   // Transitions lost because the buffer was full
+
+// Called by the port D pin-change interrupt (RoundTrip.cpp), records the levels when a recorded pin changed
+void inputTrace_portChanged();
+//=====================================================================================================================================================
+
+#endif
@@ -0,0 +1,54 @@
+//=====================================================================================================================================================
+// Shift-register I/O expander for the lines of the extra machines
+//=====================================================================================================================================================
+// A 74HC165 chain brings in the inputs and a 74HC595 chain drives the outputs, both on the SPI pins: one transfer
+// per call of expander_update() latches the outputs written since the previous one and reads every input, 2 bytes
+// in about 5 us at 4 MHz. Each machine uses one nibble of each chain, a slot; the inputs are polled, so a level is
+// accepted once two updates in a row agree (debounce of one update period).
+//=====================================================================================================================================================
+#ifndef IO_EXPANDER_H
+#define IO_EXPANDER_H
+
+#include "Hal.h"
+
+const uint8_t EXPANDER_SLOTS = 3;                 // Machines on the expander, one nibble each
+const uint8_t EXPANDER_BYTES = 2;                 // 74HC165 in the input chain, each paired with a 74HC595
+const uint8_t EXPANDER_SLOT_LINES = 4;            // Lines per slot and per chain
+
+// Lines of a slot, bit 0 to 3 of its nibble
+enum ExpanderLine {
+  EXPANDER_EMERGENCY = 0,                         // Inputs, on the 74HC165
+  EXPANDER_WALL_SWITCH = 1,
+  EXPANDER_START = 2,
+  EXPANDER_SHUTDOWN_REQUEST = 3,
+  EXPANDER_SHUTDOWN_COMMAND = 0                   // Output, on the 74HC595
+};
+
+// Sets up the SPI and the latch pins, the outputs start LOW and the levels at the current inputs
+void expander_begin();
+
+// Latches the outputs and reads the inputs, called from the input sampling task
+void expander_update();
+
+// Debounced level of an input
+uint8_t expander_level(uint8_t slot, uint8_t line);
+
+// Sets an output, driven at the next update
+void expander_write(uint8_t slot, uint8_t line, uint8_t level);
+
+// Level last written to an output
+uint8_t expander_output(uint8_t slot, uint8_t line);
+//=====================================================================================================================================================
+
+
+
+#ifndef ARDUINO
+//=====================================================================================================================================================
+// Simulation control, used by the native tests
+//=====================================================================================================================================================
+void sim_expanderSetInput(uint8_t slot, uint8_t line, uint8_t level);   // Seen by the next update, HIGH after begin
+uint8_t sim_expanderOutput(uint8_t slot, uint8_t line);                 // Level on the 74HC595 pin, as of the last update
+//=====================================================================================================================================================
+#endif
+
+#endif
@@ -0,0 +1,76 @@
+//=====================================================================================================================================================
+// Result journal in the 1 KB EEPROM
+//=====================================================================================================================================================
+// One fixed-size record per test cycle, written to the next slot of a circular layout: every slot is rewritten once
+// per JOURNAL_CAPACITY runs, which spreads the wear over the whole EEPROM. The newest record is found at power-up from
+// the run counters. A record is written byte by byte by the "EEPROM ready" interrupt, the main loop never waits for
+// the 3.4 ms of a byte write, and bytes that already hold the right value are skipped.
+//=====================================================================================================================================================
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "Hal.h"
+
+const uint16_t JOURNAL_EEPROM_SIZE = 1024;        // ATmega328P EEPROM
+const uint8_t JOURNAL_RECORD_SIZE = 16;
+const uint8_t JOURNAL_CAPACITY = JOURNAL_EEPROM_SIZE / JOURNAL_RECORD_SIZE;
+const uint8_t JOURNAL_VERDICT_BITS = 3;           // Bits per sequence verdict in JournalRecord::verdicts
+const uint8_t JOURNAL_VERDICT_NONE = 7;           // Sequence not run in this cycle
+const uint16_t JOURNAL_TIME_NONE = 0xFFFF;        // Timing not measured in this cycle
+const uint8_t JOURNAL_BOUNCE_BITS = 3;            // Bits per input in JournalRecord::bounces
+const uint8_t JOURNAL_BOUNCES_MAX = 7;            // Bounce counts saturate here
+const uint8_t JOURNAL_CHANNEL_SHIFT = 6;          // Channel of the machine in the top 2 bits of JournalRecord::bounces
+
+struct JournalRecord {
+  uint16_t run;                                   // Run counter, one more than the previous record
+  uint16_t verdicts;                              // 3 bits per sequence (Verdict or JOURNAL_VERDICT_NONE), bit 15 always 0
+  uint16_t emergencyResponse;                     // E-stop response time, in ms
+  uint16_t emergencySettle;                       // E-stop contact bounce duration, in us
+  uint16_t wallSwitchResponse;                    // Wall switch response time, in ms
+  uint16_t wallSwitchSettle;                      // Wall switch contact bounce duration, in us
+  uint16_t roundTrip;                             // Shutdown command latency, in 0.1 ms
+  uint8_t bounces;                                // E-stop bounces in bits 0-2, wall switch in bits 3-5, channel in 6-7
+  uint8_t checksum;                               // CRC-8 of the 15 bytes above
+};
+
+// Scans the EEPROM for the newest valid record
+void journal_begin();
+
+// Run counter to give to the next record
+uint16_t journal_nextRun();
+
+// Number of valid records, up to JOURNAL_CAPACITY
+uint8_t journal_count();
+
+// Queues a record (its checksum is computed here), false while the previous one is still being written
+bool journal_append(JournalRecord& record);
+
+// A record is being written, the EEPROM cannot be read
+bool journal_busy();
+
+// Reads the slots from the oldest to the newest (index 0 to JOURNAL_CAPACITY - 1), returns false for a slot that
+// does not hold a valid record or while a record is being written
+bool journal_read(uint8_t index, JournalRecord& record);
+
+// Record field helpers
+void journalRecord_clear(JournalRecord& record, uint16_t run);
+void journalRecord_setVerdict(JournalRecord& record, uint8_t sequence, uint8_t verdict);
+uint8_t journalRecord_verdict(const JournalRecord& record, uint8_t sequence);
+
+// Clamps a timing to a 16-bit field, below JOURNAL_TIME_NONE
+inline uint16_t journalRecord_time(unsigned long value) {
+  return value < JOURNAL_TIME_NONE ? value : JOURNAL_TIME_NONE - 1;
+}
+//=====================================================================================================================================================
+
+
+
+#ifndef ARDUINO
+//=====================================================================================================================================================
+// Simulation control, used by the native tests
+//=====================================================================================================================================================
+uint8_t* sim_eeprom();                            // The JOURNAL_EEPROM_SIZE bytes of the simulated EEPROM
+//=====================================================================================================================================================
+#endif
+
+#endif
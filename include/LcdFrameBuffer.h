@@ -0,0 +1,48 @@
+//=====================================================================================================================================================
+// Shadow framebuffer in front of the 20x4 I2C LCD
+//=====================================================================================================================================================
+// The screens are drawn into a RAM copy of the display. sendChanges() compares it with what the LCD already shows
+// and only queues the cells that differ, so a screen can be redrawn on every tick without clearing the LCD. Cells
+// that do not fit in the LCD queue stay different and are sent by the next call. A bus error drops cells already
+// counted as shown, the next call then rewrites the whole display.
+//=====================================================================================================================================================
+#ifndef LCD_FRAME_BUFFER_H
+#define LCD_FRAME_BUFFER_H
+
+#include "LcdI2c.h"
+
+const uint8_t LCD_COLUMNS = 20;                   // Characters per row
+const uint8_t LCD_ROWS = 4;                       // Number of rows
+
+class LcdFrameBuffer : public Print {
+public:
+  LcdFrameBuffer();
+
+  // Must be called once the LCD itself has been cleared
+  void begin();
+
+  // Drawing functions, they only modify the RAM copy
+  void clear();
+  void setCursor(uint8_t column, uint8_t row);
+  size_t write(uint8_t character) override;
+  using Print::write;
+
+  // Queues the changed cells for the LCD, as many as the queue holds, returns the number of bytes queued (characters
+  // and cursor commands)
+  uint16_t sendChanges();
+
+  uint16_t lastFrameBytes() const { return frameBytes; }     // Bytes sent by the last sendChanges()
+  unsigned long totalBytes() const { return sentBytes; }     // Bytes sent since begin()
+
+private:
+  char frame[LCD_ROWS][LCD_COLUMNS];              // Frame being drawn by the screens
+  char shown[LCD_ROWS][LCD_COLUMNS];              // Content currently visible on the LCD
+  uint8_t cursorColumn;                           // Write position in the frame
+  uint8_t cursorRow;
+  uint16_t frameBytes;
+  unsigned long sentBytes;
+  uint8_t busErrors;                              // lcd_busErrors() when shown was last known to match the LCD
+};
+//=====================================================================================================================================================
+
+#endif
@@ -0,0 +1,46 @@
+//=====================================================================================================================================================
+// Interrupt-driven 20x4 LCD on its PCF8574 I2C backpack
+//=====================================================================================================================================================
+// lcd_write() and lcd_setCursor() only queue the LCD byte and return. The TWI interrupt sends the queue as a single
+// I2C transaction, each LCD byte expanded into the six PCF8574 writes of its two 4-bit strobes, so the main loop no
+// longer waits for the bus. lcd_idle() tells it when the last queued byte has reached the display. This driver owns
+// the TWI: the Wire library must not be used in the firmware, its interrupt handler would collide with this one.
+//=====================================================================================================================================================
+#ifndef LCD_I2C_H
+#define LCD_I2C_H
+
+#include "Hal.h"
+
+const uint8_t LCD_I2C_ADDRESS = 0x27;             // PCF8574 backpack, 0x3F for a PCF8574A
+const unsigned long LCD_I2C_CLOCK = 100000;       // Fastest SCL the PCF8574 accepts, in Hz
+const uint8_t LCD_QUEUE_SIZE = 64;                // LCD bytes waiting for the bus, power of two
+
+// PCF8574 port bits on the common backpacks
+const uint8_t LCD_PORT_RS = 0x01;                 // Register select: 1 = character, 0 = command
+const uint8_t LCD_PORT_EN = 0x04;                 // Enable, the HD44780 latches D4..D7 on its falling edge
+const uint8_t LCD_PORT_BACKLIGHT = 0x08;
+
+// Initializes the TWI and the display in 4-bit mode, then clears it. Blocks for about 60 ms, call it from setup()
+void lcd_begin(uint8_t address);
+
+// Clears the display, blocks until the queue is sent and the 1.5 ms of the command have elapsed
+void lcd_clear();
+
+void lcd_setBacklight(bool on);
+
+// Queue one LCD byte each. They wait for room when the queue is full: callers that must not block check
+// lcd_queueFree() first
+void lcd_setCursor(uint8_t column, uint8_t row);
+void lcd_write(uint8_t character);
+
+// Free entries in the queue, one per lcd_setCursor() or lcd_write()
+uint8_t lcd_queueFree();
+
+// Every queued byte has been sent, set by the interrupt when it ends the transaction
+bool lcd_idle();
+
+// Transactions dropped because the backpack did not acknowledge, the bytes they held are lost
+uint8_t lcd_busErrors();
+//=====================================================================================================================================================
+
+#endif
@@ -0,0 +1,109 @@
+//=====================================================================================================================================================
+// LCD message table
+//=====================================================================================================================================================
+// Every text shown on the LCD lives in flash (PROGMEM) and is referenced by its MessageId. Texts are copied to the
+// display one byte at a time, and numbers are formatted into a small stack buffer, so the display path never
+// uses RAM strings or the heap.
+//=====================================================================================================================================================
+#ifndef MESSAGES_H
+#define MESSAGES_H
+
+#include "Hal.h"
+
+const uint8_t MESSAGE_MAX_LENGTH = 20;            // One LCD row
+const uint8_t MSG_NONE = 0xFF;                    // Empty row in a screen description
+
+// X(identifier, text): the MSG_FORMAT_ entries are printf formats used with message_printFormatted()
+#define MESSAGE_TABLE(X) \
+  X(MSG_FIRST_TEST, " First test : ") \
+  X(MSG_EMERGENCY_STOP, "EMERGENCY STOP") \
+  X(MSG_EMERGENCY_STOP_OK, "EMERGENCY STOP OK") \
+  X(MSG_PUSH_NEXT_BUTTON, "Push next button") \
+  X(MSG_IF_THE_TEST_IS_OK, "if the test is OK") \
+  X(MSG_EMERGENCY_STOP_NOK, "EMERGENCY STOP NOK") \
+  X(MSG_SECOND_TEST, "Second test :") \
+  X(MSG_CHECK_THE, "Check the") \
+  X(MSG_POWER_SUPPLY_24V, "POWER SUPPLY 24V") \
+  X(MSG_WALL_SWITCH_PRESENT, "WALL SWITCH PRESENT") \
+  X(MSG_PUSH_NEXT_BUTTON_IF, "Push next button if") \
+  X(MSG_WALL_SWITCH_MISSING, "WALL SWITCH MISSING") \
+  X(MSG_THIRD_TEST_CHECK, "Third test: check") \
+  X(MSG_IF_THE_SCANNER, " if the SCANNER") \
+  X(MSG_STARTS_UP, "STARTS UP") \
+  X(MSG_IF_FORCE, "IF FORCE:") \
+  X(MSG_IF_X_CITE_CEED_GO, "If X.CITE|CEED|GO :") \
+  X(MSG_PUSH_LITTLE_BUTTON, "Push little button") \
+  X(MSG_GANTRY_SHOULD_BE, "GANTRY SHOULD BE") \
+  X(MSG_ENERGIZED, "ENERGIZED") \
+  X(MSG_GANTRY_IS_ENERGIZED, "Gantry is ENERGIZED") \
+  X(MSG_TEST_FORCE, "Test force:") \
+  X(MSG_PUSH_THE_GREEN, "Push the GREEN") \
+  X(MSG_BUTTON_ON, "button on") \
+  X(MSG_ELECTRICAL_CABINET, "electrical cabinet") \
+  X(MSG_DID_THE_FORCE, "Did the Force") \
+  X(MSG_SYSTEM_START_UP, "system start up") \
+  X(MSG_WITHOUT_ANY_PROBLEM, "without any problem?") \
+  X(MSG_IF_YES_PUSH_NEXT, "If YES: push next") \
+  X(MSG_FOURTH_TEST, "Fourth test :") \
+  X(MSG_SHUTDOWN_REQUEST, "SHUTDOWN REQUEST") \
+  X(MSG_PUSH_THE_RED_BUTTON, "Push the RED BUTTON") \
+  X(MSG_ON_ELECTRICAL, "on electrical") \
+  X(MSG_CABINET, "cabinet") \
+  X(MSG_TITLE_SHUTDOWN_REQUEST_OK, "SHUTDOWN REQUEST OK") \
+  X(MSG_IF_THE_TEST_IS, "If the test is :") \
+  X(MSG_SHUTDOWN_REQUEST_OK, "Shutdown request OK") \
+  X(MSG_TITLE_SHUTDOWN_REQUEST_NOK, "SHUTDOWN REQUEST NOK") \
+  X(MSG_CONTACT_GLITCHES, "Contact glitches") \
+  X(MSG_ARROW_PUSH_NEXT_BUTTON, "=> Push next button") \
+  X(MSG_THE_SYSTEM_WILL, "The system will") \
+  X(MSG_SHUT_DOWN_IN, "shut down in :") \
+  X(MSG_DID_THE_SYSTEM, "Did the system ") \
+  X(MSG_SHUT_DOWN_WITHOUT, "shut down without") \
+  X(MSG_ANY_PROBLEM, "any problem ?") \
+  X(MSG_IF_YES_PUSH_NEXT_BANG, "If YES : push next!") \
+  X(MSG_TITLE_SHUTDOWN_COMMAND_OK, "SHUTDOWN COMMAND OK") \
+  X(MSG_SHUTDOWN_COMMAND_OK, "Shutdown command OK") \
+  X(MSG_FINAL_TEST, "FINAL TEST:") \
+  X(MSG_CHECK_THE_INDICATOR, "Check the indicator") \
+  X(MSG_LIGHTS_FOR_X_RAY_ON, "lights for X_RAY ON") \
+  X(MSG_AND_X_RAY_READY, "and X_RAY READY") \
+  X(MSG_IF_THE_X_RAY_TESTS, "If the X-RAY tests") \
+  X(MSG_ARE_COMPLETED, "are completed :") \
+  X(MSG_PRESS_NEXT_BUTTON, "Press next button &") \
+  X(MSG_TURN_OFF_THE_CASING, "TURN OFF the casing") \
+  X(MSG_NO_EDGE_CAPTURED, "No edge captured") \
+  X(MSG_LATENCY_MIN_AVG_MAX, "LATENCY min/avg/max") \
+  X(MSG_NO_RESPONSE, "No response") \
+  X(MSG_LAST_NO_RESPONSE, "Last: no response") \
+  X(MSG_CAPTURING, "Capturing...") \
+  X(MSG_CLEAN_EDGE, "Clean edge") \
+  X(MSG_FIRST_TESTS, " First tests :") \
+  X(MSG_E_STOP, "E-STOP") \
+  X(MSG_WALL_SWITCH, "WALL SW") \
+  X(MSG_OK, "OK") \
+  X(MSG_NOK, "NOK") \
+  X(MSG_NO_EDGE, "no edge") \
+  X(MSG_FORMAT_WAITING, "Waiting :%lus ") \
+  X(MSG_FORMAT_SECONDS, "%lus ") \
+  X(MSG_FORMAT_EDGE_STATS, "R%lums S%luus B%u") \
+  X(MSG_FORMAT_ROUND_TRIP_STATS, "%lu/%lu/%lums n%u") \
+  X(MSG_FORMAT_ROUND_TRIP_LAST, "Last: %lums") \
+  X(MSG_FORMAT_ROUND_TRIP_HISTOGRAM, "Hist %s") \
+  X(MSG_FORMAT_CAPTURE_STATS, "E%u G%u %lu-%luus") \
+  X(MSG_FORMAT_CHECK_SUMMARY, "R%lums")
+
+enum MessageId {
+#define MESSAGE_ID(id, text) id,
+  MESSAGE_TABLE(MESSAGE_ID)
+#undef MESSAGE_ID
+  MESSAGE_COUNT
+};
+
+// Prints a message from flash
+void message_print(Print& out, MessageId id);
+
+// Formats numbers into one LCD row with a message used as printf format, then prints it
+void message_printFormatted(Print& out, MessageId format, ...);
+//=====================================================================================================================================================
+
+#endif
@@ -0,0 +1,32 @@
+//=====================================================================================================================================================
+// Pins definition
+//=====================================================================================================================================================
+// Shared by the firmware and the sequence table, which references the inputs and outputs of each check.
+//=====================================================================================================================================================
+#ifndef PINS_H
+#define PINS_H
+
+#include "FastPin.h"
+
+const int pin_Emergency = 2;                      // Emergency stop signal input pin
+const int pin_Wall_switch = 3;                    // Input pin for checking the 24V DC signal on the power supply
+const int pin_Start = 5;                          // Input pin to check if the system is powered by pushing the start button of the machine
+const int pin_Shutdown_request = 6;               // Input pin for checking the scanner shutdown request
+const int out_pin_Shutdown_command = 8;           // Output pin to send a signal and turn off the scanner
+const int button_next_sequence = 7;               // Pin where the push button is connected to move to the next sequence or the next step
+const int pin_Expander_load = 9;                  // SH/LD of the 74HC165 input chain of the I/O expander (IoExpander.h)
+const int pin_Expander_latch = 10;                // RCLK of its 74HC595 output chain, also the SPI SS pin
+const int NO_PIN = 0xFF;                          // Used in the tables for steps that do not use a pin
+
+// Direct port access to the same pins, for the code that knows its pin at compile time (interrupts, setup)
+typedef FastPin<pin_Emergency> EmergencyPin;
+typedef FastPin<pin_Wall_switch> WallSwitchPin;
+typedef FastPin<pin_Start> StartPin;
+typedef FastPin<pin_Shutdown_request> ShutdownRequestPin;
+typedef FastPin<out_pin_Shutdown_command> ShutdownCommandPin;
+typedef FastPin<button_next_sequence> NextButtonPin;
+typedef FastPin<pin_Expander_load> ExpanderLoadPin;
+typedef FastPin<pin_Expander_latch> ExpanderLatchPin;
+//=====================================================================================================================================================
+
+#endif
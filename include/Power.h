@@ -0,0 +1,32 @@
+//=====================================================================================================================================================
+// Idle sleep between the scheduler passes
+//=====================================================================================================================================================
+// When no task is due the CPU sleeps in idle mode until the next interrupt. Idle only stops the CPU clock: Timer0
+// (millis / micros), Timer1 and Timer2, the USART, the TWI, the SPI and the external and pin-change interrupts keep
+// running and each of them wakes the CPU, so the edges and the round trips are timestamped by their interrupt as
+// before. Timer0 or the 1 kHz debouncer wakes it at least every millisecond, before the next task can be due.
+// The time spent asleep is measured, the remote command W reports the duty cycle since the previous report.
+//=====================================================================================================================================================
+#ifndef POWER_H
+#define POWER_H
+
+#include "Hal.h"
+
+struct PowerStats {
+  unsigned long window;                           // Time since the previous report, in ms
+  unsigned long asleep;                           // Part of it spent asleep, in ms
+  unsigned long wakeups;                          // Sleeps ended by an interrupt
+  uint16_t longestSleep;                          // Longest single sleep, in us: the worst added delay before a task runs
+};
+
+// Turns off the ADC and the analog comparator, unused by the box, and starts the first report window
+void power_begin();
+
+// Sleeps until the next interrupt unless a task is due, called at the end of loop()
+void power_idle();
+
+// Copies the statistics of the current window and starts a new one
+void power_takeStats(PowerStats& stats);
+//=====================================================================================================================================================
+
+#endif
@@ -0,0 +1,57 @@
+//=====================================================================================================================================================
+// Round-trip latency of the shutdown command
+//=====================================================================================================================================================
+// roundTrip_drive() sets out_pin_Shutdown_command and takes a micros() timestamp in the same critical section. A
+// pin-change interrupt on pin_Start (D5) and pin_Shutdown_request (D6) then timestamps the first change of either
+// input: the time the machine took to react through its relay chain. One measurement is taken per run of sequence
+// 5, the statistics accumulate over the runs since power-up.
+//=====================================================================================================================================================
+#ifndef ROUND_TRIP_H
+#define ROUND_TRIP_H
+
+#include "Hal.h"
+
+const uint8_t ROUND_TRIP_BINS = 8;                // Histogram bins: < 1 ms, then doubling up to >= 64 ms
+const unsigned long ROUND_TRIP_NONE = 0xFFFFFFFFUL;   // Latest latency when the last command got no response
+
+enum RoundTripInput {
+  ROUND_TRIP_START,                               // pin_Start answered first
+  ROUND_TRIP_SHUTDOWN_REQUEST                     // pin_Shutdown_request answered first
+};
+
+// Attaches the port D pin-change interrupt, shared with the input trace (InputTrace.h)
+void roundTrip_begin();
+
+// Drives the shutdown command and starts a measurement when the level is HIGH
+void roundTrip_drive(uint8_t level);
+
+// Returns true once per completed measurement, with the latency in us and the RoundTripInput that answered
+bool roundTrip_take(unsigned long& latency, uint8_t& input);
+
+// Stops a measurement that got no response, returns true if one was running
+bool roundTrip_cancel();
+
+
+
+//=====================================================================================================================================================
+// Statistics over the measurements
+//=====================================================================================================================================================
+struct RoundTripStats {
+  uint16_t count;                                 // Measurements with a response
+  uint16_t missed;                                // Commands that got no response before the operator moved on
+  unsigned long last;                             // Latest latency in us, ROUND_TRIP_NONE when it got no response
+  unsigned long minimum;                          // In us
+  unsigned long maximum;                          // In us
+  unsigned long mean;                             // Running mean, in us
+  uint16_t histogram[ROUND_TRIP_BINS];
+};
+
+void roundTripStats_reset(RoundTripStats& stats);
+void roundTripStats_add(RoundTripStats& stats, unsigned long latency);
+void roundTripStats_miss(RoundTripStats& stats);
+
+// Histogram bin of a latency in us
+uint8_t roundTripStats_bin(unsigned long latency);
+//=====================================================================================================================================================
+
+#endif
@@ -0,0 +1,47 @@
+//=====================================================================================================================================================
+// Cooperative task scheduler
+//=====================================================================================================================================================
+// Small millis()-based scheduler: every task is a short function that does one step of work and returns.
+// Nothing registered here is allowed to wait with delay() or spin on an input, so every task gets its turn
+// on each pass of loop().
+//=====================================================================================================================================================
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "Hal.h"
+
+const uint8_t SCHEDULER_MAX_TASKS = 8;            // Maximum number of tasks that can be registered
+
+typedef void (*TaskFunction)();                   // A task runs one step and returns immediately
+
+struct Task {
+  TaskFunction run;                               // Function executed when the task is due
+  unsigned long interval;                         // Period in milliseconds (0 = run on every pass)
+  unsigned long lastRun;                          // millis() timestamp of the last execution
+};
+
+// Registers a periodic task, returns false if the task table is full
+bool scheduler_addTask(TaskFunction run, unsigned long interval);
+
+// Runs every task whose period has elapsed, must be called from loop()
+void scheduler_run();
+
+// True when a task's period has elapsed, checked before sleeping
+bool scheduler_due();
+
+
+
+//=====================================================================================================================================================
+// Non-blocking timer used to replace delay() inside the sequences
+//=====================================================================================================================================================
+struct Timer {
+  unsigned long start;                            // millis() timestamp when the timer was started
+  unsigned long duration;                         // Duration in milliseconds
+};
+
+void timer_start(Timer& timer, unsigned long duration);
+bool timer_expired(const Timer& timer);
+unsigned long timer_remainingSeconds(const Timer& timer);   // Rounded up, as shown in the countdowns
+//=====================================================================================================================================================
+
+#endif
@@ -0,0 +1,112 @@
+//=====================================================================================================================================================
+// Test sequence descriptions
+//=====================================================================================================================================================
+// Every sequence is a list of steps stored in flash. A step shows a screen and ends on a timeout, on an input reaching
+// its expected level, or on an operator confirmation; the interpreter in main.cpp runs them one step at a time.
+// Consecutive passive sequences (a summary message in their descriptor) run together as one group: their steps
+// advance in lock-step, with a shared countdown, the group screens and a single confirmation. Adding a machine check
+// only means adding screens and steps here.
+//=====================================================================================================================================================
+#ifndef SEQUENCE_TABLE_H
+#define SEQUENCE_TABLE_H
+
+#include "Hal.h"
+#include "LcdFrameBuffer.h"
+
+enum SequenceState {
+  SEQUENCE_1,                                     // Emergency stop
+  SEQUENCE_2,                                     // Wall switch feedback
+  SEQUENCE_3,                                     // Scanner start
+  SEQUENCE_4,                                     // Shutdown request
+  SEQUENCE_5,                                     // Shutdown command
+  SEQUENCE_COUNT
+};
+
+enum ScreenId {
+  SCREEN_EMERGENCY_COUNTDOWN,
+  SCREEN_EMERGENCY_OK,
+  SCREEN_EMERGENCY_NOK,
+  SCREEN_WALL_SWITCH_COUNTDOWN,
+  SCREEN_WALL_SWITCH_PRESENT,
+  SCREEN_WALL_SWITCH_MISSING,
+  SCREEN_START_SCANNER_COUNTDOWN,
+  SCREEN_START_SCANNER_CHOICE,
+  SCREEN_START_SCANNER_ENERGIZED,
+  SCREEN_START_SCANNER_FORCE,
+  SCREEN_START_SCANNER_FORCE_QUESTION,
+  SCREEN_SHUTDOWN_REQUEST_COUNTDOWN,
+  SCREEN_SHUTDOWN_REQUEST_PUSH_RED,
+  SCREEN_SHUTDOWN_REQUEST_OK,
+  SCREEN_SHUTDOWN_REQUEST_GLITCH,
+  SCREEN_SHUTDOWN_COMMAND_COUNTDOWN,
+  SCREEN_SHUTDOWN_COMMAND_QUESTION,
+  SCREEN_SHUTDOWN_COMMAND_OK,
+  SCREEN_SHUTDOWN_COMMAND_LATENCY,
+  SCREEN_SHUTDOWN_COMMAND_FINAL_TEST,
+  SCREEN_SHUTDOWN_COMMAND_TURN_OFF,
+  SCREEN_PASSIVE_COUNTDOWN,
+  SCREEN_PASSIVE_SUMMARY,
+  SCREEN_COUNT                                    // No screen
+};
+
+
+
+//=====================================================================================================================================================
+// Screens: one message per row, MSG_FORMAT_ rows are filled with live values (countdown, edge timing), the
+// MSG_FORMAT_CHECK_SUMMARY rows with the checks of the running group, in order
+//=====================================================================================================================================================
+struct ScreenLine {
+  uint8_t column;                                 // Column of the first character
+  uint8_t message;                                // MessageId, or MSG_NONE for an empty row
+};
+
+struct ScreenDescriptor {
+  ScreenLine lines[LCD_ROWS];
+};
+
+
+
+//=====================================================================================================================================================
+// Steps
+//=====================================================================================================================================================
+const uint8_t STEP_CONFIRM = 0x01;                // An operator press ends the step and goes to onPress
+const uint8_t STEP_WAIT_LEVEL = 0x02;             // The step ends as soon as the input reaches the expected level, then goes to next
+const uint8_t STEP_SHOW_LEVEL = 0x04;             // Passive check: screen while the input is at the expected level, failScreen otherwise
+const uint8_t STEP_DRIVE_OUTPUT = 0x08;           // The pin is an output, driven to the level when the step starts
+const uint8_t STEP_TIME_RESPONSE = 0x10;          // With STEP_DRIVE_OUTPUT: the machine's response to the shutdown command is timed
+const uint8_t STEP_CAPTURE = 0x20;                // With STEP_WAIT_LEVEL: the shutdown request line is captured at 10 kHz around its edge
+
+const uint8_t STEP_END = 0xFF;                    // Transition target that ends the sequence
+const uint8_t SETTLE_WINDOW = 10;                 // Default stability window of the countdowns: 1 s
+
+struct StepDescriptor {
+  uint8_t screen;                                 // ScreenId shown during the step (prompt)
+  uint8_t failScreen;                             // ScreenId shown by a passive check when the level is not the expected one,
+                                                  // or by the step after a capture when the trace has glitches
+  uint8_t groupScreen;                            // ScreenId shown instead of screen when the sequence runs in a group
+  uint8_t pin;                                    // Input checked or output driven by the step, NO_PIN if none
+  uint8_t level;                                  // Expected input level or output level
+  uint8_t seconds;                                // Countdown / timeout in seconds, 0 = no timeout; when it expires the step goes to next
+  uint8_t settle;                                 // Stability window in 100 ms units: the countdown ends early, to next, once the pin
+                                                  // has held the level that long. 0 = fixed countdown
+  uint8_t flags;                                  // STEP_ flags
+  uint8_t next;                                   // Step after the timeout or the expected level
+  uint8_t onPress;                                // Step after an operator confirmation
+};
+
+struct SequenceDescriptor {
+  const StepDescriptor* steps;                    // Steps of the sequence, in flash
+  uint8_t stepCount;
+  uint8_t edgeChannel;                            // EdgeChannel measured during the sequence, EDGE_CHANNEL_COUNT if none
+  uint8_t summary;                                // MessageId naming a passive check on the group summary, MSG_NONE for a
+                                                  // sequence that always runs alone
+};
+
+// The tables are in flash, these functions copy one entry to RAM
+void sequenceTable_readStep(uint8_t sequence, uint8_t step, StepDescriptor& out);
+void sequenceTable_readScreen(uint8_t screen, ScreenDescriptor& out);
+uint8_t sequenceTable_edgeChannel(uint8_t sequence);
+uint8_t sequenceTable_summary(uint8_t sequence);
+//=====================================================================================================================================================
+
+#endif
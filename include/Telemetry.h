@@ -0,0 +1,91 @@
+//=====================================================================================================================================================
+// Binary telemetry stream sent over the UART
+//=====================================================================================================================================================
+// Frame layout, multi-byte fields little-endian:
+//   0xA5 | type | payload length | payload | CRC-16/CCITT-FALSE of type, length and payload
+// The frames are queued in the UART ring buffer; a frame that does not fit is dropped and counted, the test logic
+// never waits for the serial line. tools/telemetry_decode.py decodes and archives the stream on the line PC, and
+// sends the one-byte remote-control commands listed in main.cpp; their answers come back as frames of this stream.
+//=====================================================================================================================================================
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "Hal.h"
+#include "EdgeCapture.h"
+#include "RoundTrip.h"
+#include "InputTrace.h"
+#include "Journal.h"
+#include "Power.h"
+#include "WaveCapture.h"
+
+const uint8_t TELEMETRY_SYNC = 0xA5;              // First byte of every frame
+const uint8_t TELEMETRY_MAX_PAYLOAD = 16;
+const uint8_t TELEMETRY_FRAME_OVERHEAD = 5;       // Sync, type, length and CRC around the payload
+
+enum TelemetryFrameType {
+  FRAME_SEQUENCE_START = 0x01,                    // sequence, time (ms)
+  FRAME_SEQUENCE_END = 0x02,                      // sequence, verdict, time (ms), duration (ms), settle time (ms)
+  FRAME_EDGE = 0x03,                              // channel, level, time (us)
+  FRAME_EDGE_STATS = 0x04,                        // sequence, channel, edges, bounces, response time (us), settle time (us)
+  FRAME_ROUND_TRIP = 0x05,                        // RoundTripInput, latency (us)
+  FRAME_ROUND_TRIP_STATS = 0x06,                  // count (16 bits), missed (16 bits), min, mean, max (us)
+  FRAME_ROUND_TRIP_HISTOGRAM = 0x07,              // ROUND_TRIP_BINS counts (16 bits)
+  FRAME_JOURNAL_RECORD = 0x08,                    // JournalRecord, field by field
+  FRAME_JOURNAL_END = 0x09,                       // number of records sent by the dump
+  FRAME_CAPTURE_STATS = 0x0A,                     // edges, glitches, min width (us), max width (us), sample period (us, 16 bits),
+                                                  // samples (16 bits), trigger sample (16 bits)
+  FRAME_CAPTURE_TRACE = 0x0B,                     // byte offset, up to 15 bytes of trace, bit 0 = oldest sample
+  FRAME_STATUS = 0x0C,                            // sequence, step, screen, input levels (bit n = pin Dn), shutdown command
+                                                  // level, countdown (s, 16 bits)
+  FRAME_CYCLE_RECORD = 0x0D,                      // JournalRecord of the running cycle, same layout, checksum not computed yet
+  FRAME_COMMAND_ACK = 0x0E,                       // command, accepted, sequence running after the command
+  FRAME_INPUT_TRACE_START = 0x0F,                 // start time (us), levels of the recorded pins (bit n = pin Dn)
+  FRAME_INPUT_TRANSITION = 0x10,                  // time since the start (us), levels after the change
+  FRAME_INPUT_TRACE_END = 0x11,                   // transitions captured, transitions lost
+  FRAME_POWER_STATS = 0x12                        // window (ms), asleep (ms), wakeups, longest sleep (us, 16 bits)
+};
+
+const uint8_t TELEMETRY_CHANNEL_SHIFT = 5;        // The sequence fields carry the channel of the machine in bits 5-7
+
+// Sequence field of the frames: the sequence in the low bits, above it the channel, 0 on a single machine
+inline uint8_t telemetry_sequenceField(uint8_t channel, uint8_t sequence) {
+  return sequence | (channel << TELEMETRY_CHANNEL_SHIFT);
+}
+
+const unsigned long SETTLE_NONE = 0xFFFFFFFFUL;   // Settle time of a sequence whose input never settled before the timeout
+
+enum Verdict {
+  VERDICT_OK,                                     // The input reached its expected level
+  VERDICT_NOK,                                    // The input was not at its expected level when the operator moved on
+  VERDICT_NO_SIGNAL,                              // The operator moved on before the awaited signal arrived
+  VERDICT_CONFIRMED,                              // No signal to check, confirmed by the operator
+  VERDICT_SKIPPED                                 // Ended by a remote command before its checks were done
+};
+
+void telemetry_begin();
+void telemetry_sequenceStart(uint8_t sequence);
+void telemetry_sequenceEnd(uint8_t sequence, uint8_t verdict, unsigned long duration, unsigned long settleTime);
+void telemetry_edge(const EdgeEvent& edge);
+void telemetry_edgeStats(uint8_t sequence, uint8_t channel, const EdgeStats& stats);
+void telemetry_roundTrip(uint8_t input, unsigned long latency);
+void telemetry_roundTripStats(const RoundTripStats& stats);   // Sends the statistics and histogram frames
+void telemetry_journalRecord(const JournalRecord& record);
+void telemetry_journalEnd(uint8_t records);
+void telemetry_captureStats(const WaveStats& stats);
+void telemetry_captureTrace(uint8_t offset, uint8_t length);  // Sends length bytes of the trace from the offset
+void telemetry_status(uint8_t sequence, uint8_t step, uint8_t screen, uint8_t levels, uint8_t output, uint16_t countdown);
+void telemetry_cycleRecord(const JournalRecord& record);
+void telemetry_commandAck(uint8_t command, bool accepted, uint8_t sequence);
+void telemetry_inputTraceStart(unsigned long time, uint8_t levels);
+void telemetry_inputTransition(const InputTransition& transition);
+void telemetry_inputTraceEnd(uint16_t transitions, uint8_t overflows);
+void telemetry_powerStats(const PowerStats& stats);
+
+// Number of frames dropped because the transmit buffer was full
+uint16_t telemetry_droppedFrames();
+
+// CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF), also used by the decoder
+uint16_t telemetry_crc16(uint16_t crc, const uint8_t* data, uint8_t length);
+//=====================================================================================================================================================
+
+#endif
@@ -0,0 +1,41 @@
+//=====================================================================================================================================================
+// Interrupt-driven UART with fixed transmit and receive ring buffers
+//=====================================================================================================================================================
+// uart_write() only copies bytes into the transmit ring, the USART "data register empty" interrupt sends them in the
+// background, so logging never waits for the serial line. When the ring is full the whole message is refused instead
+// of blocking. This driver owns USART0: the Arduino Serial object must not be used in the firmware, its interrupt
+// handlers would collide with these ones.
+//=====================================================================================================================================================
+#ifndef UART_H
+#define UART_H
+
+#include "Hal.h"
+
+const unsigned long UART_BAUD_RATE = 115200;
+const uint8_t UART_TX_BUFFER_SIZE = 128;          // Power of two
+const uint8_t UART_RX_BUFFER_SIZE = 32;           // Power of two
+
+void uart_begin(unsigned long baudRate);
+
+// Queues all the bytes, or none of them if the ring does not have room for the whole message
+bool uart_write(const uint8_t* data, uint8_t length);
+
+// Free space in the transmit ring
+uint8_t uart_txFree();
+
+// Next received byte, -1 when nothing was received
+int uart_read();
+//=====================================================================================================================================================
+
+
+
+#ifndef ARDUINO
+//=====================================================================================================================================================
+// Simulation control, used by the native tests
+//=====================================================================================================================================================
+size_t sim_uartTake(uint8_t* buffer, size_t size);          // Sends the queued bytes, as the interrupt would, and returns them
+void sim_uartReceive(const uint8_t* data, size_t length);   // Bytes arriving on the RX line
+//=====================================================================================================================================================
+#endif
+
+#endif
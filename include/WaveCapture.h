@@ -0,0 +1,55 @@
+//=====================================================================================================================================================
+// High-rate capture of the shutdown request line
+//=====================================================================================================================================================
+// Timer1 samples pin_Shutdown_request at 10 kHz into a bit-packed RAM ring. The ring runs continuously once armed;
+// the first edge to the trigger level freezes CAPTURE_PRE_TRIGGER samples before it, and sampling stops when the
+// rest of the ring has been filled after it. The trace then shows every bounce, chatter or glitch of the relay
+// contact at 100 us resolution, which a once-per-loop digitalRead() cannot see.
+//=====================================================================================================================================================
+#ifndef WAVE_CAPTURE_H
+#define WAVE_CAPTURE_H
+
+#include "Hal.h"
+
+const uint16_t CAPTURE_SAMPLE_PERIOD_US = 100;    // 10 kHz
+const uint8_t CAPTURE_BUFFER_SIZE = 128;          // Bytes of trace, 8 samples per byte
+const uint16_t CAPTURE_SAMPLES = CAPTURE_BUFFER_SIZE * 8;  // 102.4 ms of trace
+const uint16_t CAPTURE_PRE_TRIGGER = CAPTURE_SAMPLES / 4;  // Samples kept before the trigger edge
+const unsigned long CAPTURE_BOUNCE_US = 5000;     // Contact bounce after the trigger edge, longer than the debouncer
+const unsigned long CAPTURE_GLITCH_US = 5000;     // A level held for less than this after the bounce is a glitch
+
+// Starts sampling, the capture triggers on the first edge to the given level
+void waveCapture_arm(uint8_t triggerLevel);
+
+// Stops sampling, the trace is discarded unless the capture is done
+void waveCapture_stop();
+
+bool waveCapture_armed();                         // Sampling, triggered or not
+bool waveCapture_done();                          // A complete trace is available
+
+// Byte of the trace, from the oldest sample: bit 0 is the first sample of the byte
+uint8_t waveCapture_traceByte(uint8_t index);
+
+// Sample index of the trigger edge in the trace
+uint16_t waveCapture_triggerSample();
+
+
+
+//=====================================================================================================================================================
+// Analysis of a complete trace
+//=====================================================================================================================================================
+struct WaveStats {
+  uint8_t edges;                                  // Transitions in the trace
+  uint8_t bounces;                                // Edges within CAPTURE_BOUNCE_US after the trigger edge
+  uint8_t glitches;                               // Levels held less than CAPTURE_GLITCH_US between two edges, starting
+                                                  // after the bounce: the contact opened or closed once settled
+  unsigned long minWidth;                         // Shortest level between two edges, in us, 0 with fewer than two edges
+  unsigned long maxWidth;                         // Longest level between two edges, in us
+};
+
+// A healthy contact bounces when it closes, which the debouncer absorbs: only the levels after CAPTURE_BOUNCE_US
+// can be glitches
+void waveCapture_analyse(WaveStats& stats);
+//=====================================================================================================================================================
+
+#endif
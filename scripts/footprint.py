@@ -0,0 +1,291 @@
+# PlatformIO footprint target: flash, .data, .bss and worst-case stack of every module, checked against the budgets
+# of platformio.ini. Run with: pio run -e uno -t footprint
+#
+# The section sizes come from the linker map, so only what survives --gc-sections is counted. The stack figures
+# combine the frame of each function (-fstack-usage in build_flags; on the AVR it includes the return address and
+# the saved registers) with the call graph read from the disassembly: the worst case of a module is its deepest call
+# chain, the worst case of the firmware the deepest chain from main() plus the deepest interrupt, as the interrupts
+# do not nest. The graph is walked from main(), the interrupt handlers and the static constructors only: the avr-libc
+# startup code and the libgcc table jump of RUNTIME_SYMBOLS are left out. The graph is keyed on the symbol names, so
+# the overloads of a function are separate nodes; the .su files only give the printable name, an overload is charged
+# the largest frame of its name. Indirect calls, through a function pointer or a virtual function, are resolved with
+# custom_footprint_indirect_calls: an unresolved one fails the check, the stack of its targets would be missing.
+import os
+import re
+import subprocess
+import sys
+
+Import("env")
+
+SRAM_SIZE = 2048                                  # ATmega328P
+MAP_NAME = "firmware.map"
+
+# avr-libc startup, run before main() with interrupts off: __bad_interrupt jumps back to __vectors, the constructors
+# are reached through the ijmp of __tablejump2__. A jump to __tablejump2__ from a function is a switch, its ijmp lands
+# in the caller. The constructors are roots of their own, _GLOBAL__sub_I_*.
+RUNTIME_SYMBOLS = {"__vectors", "__bad_interrupt", "__ctors_start", "__ctors_end", "__dtors_start", "__dtors_end",
+                   "__init", "__do_copy_data", "__do_clear_bss", "__do_global_ctors", "__do_global_dtors",
+                   "__tablejump__", "__tablejump2__"}
+
+env.Append(LINKFLAGS=["-Wl,-Map,%s" % os.path.join(env.subst("$BUILD_DIR"), MAP_NAME)])
+
+
+# Section sizes per module, from the linker map
+def module_name(path):
+    path = path.strip()
+    archive = re.match(r".*?([^/\\]+)\.a\((.+)\)$", path)
+    if archive:
+        return "libgcc" if archive.group(1).startswith("libgcc") else "framework"
+    base = os.path.basename(path)
+    if os.sep + "src" + os.sep not in path and "/src/" not in path:
+        return "framework"
+    return re.sub(r"\.(cpp|c|S)\.o$", "", base)
+
+
+def read_map(map_path):
+    sizes = {}
+    output = None
+    pending = None                                # Input section whose address and size are on the next line
+    started = False
+    with open(map_path) as map_file:
+        for line in map_file:
+            if line.startswith("Linker script and memory map"):
+                started = True
+                continue
+            if not started:
+                continue
+            output_match = re.match(r"^(\.[\w.]+)", line)
+            if output_match:
+                output = output_match.group(1)
+                continue
+            if pending is not None:
+                fields = line.split()
+                if len(fields) >= 3 and fields[0].startswith("0x"):
+                    add_section(sizes, output, int(fields[1], 16), " ".join(fields[2:]))
+                pending = None
+                continue
+            fields = line.split()
+            if not line.startswith(" ") or not fields or not (fields[0].startswith(".") or fields[0] == "COMMON"):
+                continue
+            if len(fields) == 1:
+                pending = fields[0]
+            elif len(fields) >= 4 and fields[1].startswith("0x"):
+                add_section(sizes, output, int(fields[2], 16), " ".join(fields[3:]))
+    return sizes
+
+
+def add_section(sizes, output, size, path):
+    if output not in (".text", ".data", ".bss", ".noinit") or size == 0:
+        return
+    key = {".text": "text", ".data": "data", ".bss": "bss", ".noinit": "bss"}[output]
+    module = sizes.setdefault(module_name(path), {"text": 0, "data": 0, "bss": 0})
+    module[key] += size
+
+
+# Worst-case stack, from the -fstack-usage files and the disassembly
+def function_key(name):
+    """Name without return type, template arguments nor parameters: the .su files and c++filt print them differently"""
+    plain = re.sub(r"\s*\[with .*\]$", "", name).split("(")[0]
+    for _ in range(8):
+        plain = re.sub(r"<[^<>]*>", "", plain)
+    fields = plain.split()
+    return fields[-1] if fields else name
+
+
+def read_stack_usage(build_dir):
+    frames = {}                                   # Function key: (frame size, module)
+    for root, _, files in os.walk(build_dir):
+        for file_name in files:
+            if not file_name.endswith(".su"):
+                continue
+            module = module_name(os.path.join(root, file_name[:-3] + ".o"))
+            with open(os.path.join(root, file_name)) as su_file:
+                for line in su_file:
+                    fields = line.rstrip("\n").split("\t")
+                    if len(fields) < 2:
+                        continue
+                    location = re.match(r"^.*?:\d+:\d+:(.*)$", fields[0])
+                    key = function_key(location.group(1) if location else fields[0])
+                    size = int(fields[1])
+                    if key not in frames or size > frames[key][0]:
+                        frames[key] = (size, module)
+    return frames
+
+
+def read_call_graph(elf_path):
+    objdump = env.subst("$OBJCOPY").replace("objcopy", "objdump")
+    output = subprocess.check_output([objdump, "-d", elf_path]).decode(errors="replace")
+    calls = {}                                    # Symbol: set of callee symbols
+    indirect = set()                              # Symbols with an icall
+    current = None
+    for line in output.splitlines():
+        header = re.match(r"^[0-9a-f]+ <(.+)>:$", line)
+        if header:
+            current = None if header.group(1) in RUNTIME_SYMBOLS else header.group(1)
+            if current is not None:
+                calls.setdefault(current, set())
+            continue
+        if current is None:
+            continue
+        instruction = re.search(r"\t(r?call|r?jmp|e?icall|e?ijmp)\b", line)
+        if not instruction:
+            continue
+        if instruction.group(1) in ("icall", "eicall", "ijmp", "eijmp"):
+            indirect.add(current)
+            continue
+        target = re.search(r"<(.+)>\s*$", line[instruction.end():])
+        if not target:
+            continue
+        # A jump inside the function is a branch, a jump to the start of another one is a tail call
+        callee = re.sub(r"\+0x[0-9a-f]+$", "", target.group(1))
+        if callee != current and callee not in RUNTIME_SYMBOLS:
+            calls[current].add(callee)
+    return calls, indirect
+
+
+def demangle(symbols):
+    """Symbol: demangled name, from the c++filt of the toolchain"""
+    cxxfilt = env.subst("$OBJCOPY").replace("objcopy", "c++filt")
+    symbols = sorted(symbols)
+    output = subprocess.check_output([cxxfilt], input="\n".join(symbols).encode()).decode(errors="replace")
+    return dict(zip(symbols, output.splitlines()))
+
+
+def symbol_frames(names, frames):
+    """Symbol: (frame size, module) for the symbols found in the .su files"""
+    return {symbol: frames[function_key(name)] for symbol, name in names.items() if function_key(name) in frames}
+
+
+def resolve(name, names):
+    """Symbols named in custom_footprint_indirect_calls: a mangled name is one overload, a plain name all of them"""
+    if name in names:
+        return [name]
+    return [symbol for symbol, demangled in names.items() if function_key(demangled) == name]
+
+
+def resolve_indirect_calls(indirect_calls, names):
+    targets = {}                                  # Symbol: set of the symbols its icalls can reach
+    for caller, callees in indirect_calls.items():
+        for symbol in resolve(caller, names):
+            targets.setdefault(symbol, set()).update(*[resolve(callee, names) for callee in callees])
+    return targets
+
+
+def is_root(function):
+    """main(), an interrupt handler or a static constructor: the chains start there"""
+    return function == "main" or re.match(r"(__vector_\d+|_GLOBAL__sub_I_.*)$", function) is not None
+
+
+def worst_stacks(calls, frames, indirect_targets, names):
+    """Worst-case stack of every function reached from a root"""
+    depths = {}
+    unknown = set()
+
+    def depth(function, path):
+        if function in path:
+            raise ValueError("recursion: " + " -> ".join(names.get(symbol, symbol) for symbol in path + [function]))
+        if function in depths:
+            return depths[function]
+        if function not in frames:
+            unknown.add(names.get(function, function))
+        callees = calls.get(function, set()) | indirect_targets.get(function, set())
+        deepest = max([depth(callee, path + [function]) for callee in callees] or [0])
+        depths[function] = frames.get(function, (0, None))[0] + deepest
+        return depths[function]
+
+    for function in calls:
+        if is_root(function):
+            depth(function, [])
+    return depths, unknown
+
+
+# Budgets and report
+def read_budgets():
+    """custom_footprint_budget lines: 'total flash=... sram=... stack=... free=...' or '<module> flash=... sram=...'"""
+    budgets = {}
+    for line in env.GetProjectOption("custom_footprint_budget", "").splitlines():
+        fields = line.split()
+        if fields:
+            budgets[fields[0]] = {key: int(value) for key, value in (field.split("=") for field in fields[1:])}
+    return budgets
+
+
+def read_indirect_calls():
+    """custom_footprint_indirect_calls lines: '<caller>: <callee> <callee> ...', plain or mangled names"""
+    targets = {}
+    for line in env.GetProjectOption("custom_footprint_indirect_calls", "").splitlines():
+        if ": " in line:
+            caller, callees = line.split(": ", 1)
+            targets[caller.strip()] = callees.split()
+    return targets
+
+
+def footprint(source, target, env):
+    build_dir = env.subst("$BUILD_DIR")
+    elf_path = env.subst("$BUILD_DIR/${PROGNAME}.elf")
+    sizes = read_map(os.path.join(build_dir, MAP_NAME))
+    calls, indirect = read_call_graph(elf_path)
+    names = demangle(set(calls) | set().union(*calls.values()))
+    frames = symbol_frames(names, read_stack_usage(build_dir))
+    indirect_targets = resolve_indirect_calls(read_indirect_calls(), names)
+    try:
+        depths, unknown = worst_stacks(calls, frames, indirect_targets, names)
+    except ValueError as error:
+        sys.stderr.write("Footprint: %s, the stack cannot be bounded\n" % error)
+        env.Exit(1)
+
+    module_stack = {}
+    for function, depth in depths.items():
+        module = frames[function][1] if function in frames else None
+        if module is not None:
+            module_stack[module] = max(module_stack.get(module, 0), depth)
+
+    # The constructors run before main(), with interrupts off
+    interrupts = [depths[function] for function in depths if re.match(r"__vector_\d+$", function)]
+    constructors = [depths[function] for function in depths if function.startswith("_GLOBAL__sub_I_")]
+    total = {
+        "flash": sum(module["text"] + module["data"] for module in sizes.values()),
+        "sram": sum(module["data"] + module["bss"] for module in sizes.values()),
+        "stack": max([depths.get("main", 0) + max(interrupts or [0])] + constructors),
+    }
+    total["free"] = SRAM_SIZE - total["sram"] - total["stack"]
+
+    print("Footprint (bytes):")
+    print("  %-16s %6s %6s %6s %6s" % ("module", "flash", "data", "bss", "stack"))
+    for name in sorted(sizes, key=lambda module: -(sizes[module]["text"] + sizes[module]["data"])):
+        module = sizes[name]
+        print("  %-16s %6d %6d %6d %6s" % (name, module["text"] + module["data"], module["data"], module["bss"],
+                                           module_stack.get(name, "-")))
+    print("  %-16s %6d %13d %6d   free SRAM %d" % ("total", total["flash"], total["sram"], total["stack"],
+                                                   total["free"]))
+    if unknown:
+        print("  no stack usage for: " + ", ".join(sorted(unknown)))
+
+    failures = []
+    for symbol in sorted(function for function in indirect if function in depths and function not in indirect_targets):
+        failures.append("%s (%s): indirect call without targets in custom_footprint_indirect_calls"
+                        % (names.get(symbol, symbol), symbol))
+    for name, limits in read_budgets().items():
+        if name == "total":
+            figures = total
+        else:
+            module = sizes.get(name, {"text": 0, "data": 0, "bss": 0})
+            figures = {"flash": module["text"] + module["data"], "sram": module["data"] + module["bss"],
+                       "stack": module_stack.get(name, 0)}
+        for key, limit in limits.items():
+            value = figures.get(key, 0)
+            # The free SRAM is a minimum, the other figures maximums
+            if (value < limit) if key == "free" else (value > limit):
+                failures.append("%s %s: %d, budget %d" % (name, key, value, limit))
+    if failures:
+        sys.stderr.write("Footprint check failed:\n  " + "\n  ".join(failures) + "\n")
+        env.Exit(1)
+
+
+env.AddCustomTarget(
+    name="footprint",
+    dependencies="$BUILD_DIR/${PROGNAME}.elf",
+    actions=footprint,
+    title="Footprint",
+    description="Flash, SRAM and worst-case stack per module, checked against the budgets",
+)
@@ -0,0 +1,52 @@
+# PlatformIO post-build script: prints the static SRAM usage of the firmware and the difference with the previous build.
+#
+# .data and .bss are read from the ELF with avr-size. The result is stored in the build directory so the next build
+# can show the before / after numbers of a change.
+import json
+import os
+import subprocess
+
+Import("env")
+
+SRAM_SIZE = 2048                                  # ATmega328P
+
+
+def read_sections(elf_path):
+    output = subprocess.check_output([env.subst("$SIZETOOL"), "-A", elf_path]).decode()
+    sections = {}
+    for line in output.splitlines():
+        fields = line.split()
+        if len(fields) >= 2 and fields[0].startswith(".") and fields[1].isdigit():
+            sections[fields[0]] = int(fields[1])
+    return sections
+
+
+def memory_report(source, target, env):
+    elf_path = str(target[0])
+    sections = read_sections(elf_path)
+    current = {
+        "data": sections.get(".data", 0),
+        "bss": sections.get(".bss", 0),
+        "flash": sections.get(".text", 0) + sections.get(".data", 0),
+    }
+    current["sram"] = current["data"] + current["bss"]
+
+    report_path = os.path.join(env.subst("$BUILD_DIR"), "memory_report.json")
+    previous = None
+    if os.path.exists(report_path):
+        with open(report_path) as report_file:
+            previous = json.load(report_file)
+
+    print("Memory report:")
+    for key in ("flash", "data", "bss", "sram"):
+        line = "  %-6s %6d bytes" % (key, current[key])
+        if previous is not None and key in previous:
+            line += "   (before: %6d, delta: %+d)" % (previous[key], current[key] - previous[key])
+        print(line)
+    print("  free SRAM for the stack and buffers: %d bytes" % (SRAM_SIZE - current["sram"]))
+
+    with open(report_path, "w") as report_file:
+        json.dump(current, report_file)
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", memory_report)
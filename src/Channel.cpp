@@ -0,0 +1,88 @@
+#include "Channel.h"
+#include "Debouncer.h"
+#include "Pins.h"
+
+
+
+//=====================================================================================================================================================
+// Lines of a channel: the Uno pins for channel 0, the slot channel - 1 of the expander for the others
+//=====================================================================================================================================================
+// Expander output of an output pin of the sequence table, EXPANDER_SLOT_LINES for a pin that has none
+static uint8_t expanderOutput(uint8_t pin) {
+  if (pin == out_pin_Shutdown_command) {
+    return EXPANDER_SHUTDOWN_COMMAND;
+  }
+  return EXPANDER_SLOT_LINES;
+}
+
+void channel_begin(Channel& channel, uint8_t index) {
+  channel.index = index;
+  channel.laneCount = 1;
+  channel.inputs.emergency = HIGH;
+  channel.inputs.wallSwitch = HIGH;
+  channel.inputs.start = HIGH;
+  channel.inputs.shutdownRequest = HIGH;
+  channel.inputs.button = HIGH;
+  channel.buttonPressed = false;
+  channel.roundTripTimed = false;
+  channel.screen = SCREEN_COUNT;
+  channel.countdownValue = 0;
+}
+
+void channel_sampleInputs(Channel& channel) {
+  InputState& inputs = channel.inputs;
+  if (channel.index == 0) {
+    inputs.emergency = debouncer_level(pin_Emergency);
+    inputs.wallSwitch = debouncer_level(pin_Wall_switch);
+    inputs.start = debouncer_level(pin_Start);
+    inputs.shutdownRequest = debouncer_level(pin_Shutdown_request);
+  } else {
+    uint8_t slot = channel.index - 1;
+    inputs.emergency = expander_level(slot, EXPANDER_EMERGENCY);
+    inputs.wallSwitch = expander_level(slot, EXPANDER_WALL_SWITCH);
+    inputs.start = expander_level(slot, EXPANDER_START);
+    inputs.shutdownRequest = expander_level(slot, EXPANDER_SHUTDOWN_REQUEST);
+  }
+  inputs.button = debouncer_level(button_next_sequence);
+}
+
+uint8_t channel_inputLevel(const Channel& channel, uint8_t pin) {
+  switch (pin) {
+    case pin_Emergency:
+      return channel.inputs.emergency;
+    case pin_Wall_switch:
+      return channel.inputs.wallSwitch;
+    case pin_Start:
+      return channel.inputs.start;
+    case pin_Shutdown_request:
+      return channel.inputs.shutdownRequest;
+    default:
+      // An unwired expander line reads released, like a pull-up
+      return channel.index == 0 ? hal_digitalRead(pin) : HIGH;
+  }
+}
+
+void channel_writeOutput(const Channel& channel, uint8_t pin, uint8_t level) {
+  if (channel.index != 0) {
+    if (expanderOutput(pin) < EXPANDER_SLOT_LINES) {
+      expander_write(channel.index - 1, expanderOutput(pin), level);
+    }
+    return;
+  }
+  switch (pin) {
+    case out_pin_Shutdown_command:
+      ShutdownCommandPin::write(level);
+      break;
+    default:
+      hal_digitalWrite(pin, level);
+      break;
+  }
+}
+
+uint8_t channel_outputLevel(const Channel& channel, uint8_t pin) {
+  if (channel.index != 0) {
+    return expanderOutput(pin) < EXPANDER_SLOT_LINES ? expander_output(channel.index - 1, expanderOutput(pin)) : LOW;
+  }
+  return pin == out_pin_Shutdown_command ? ShutdownCommandPin::read() : hal_digitalRead(pin);
+}
+//=====================================================================================================================================================
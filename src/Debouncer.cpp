@@ -0,0 +1,115 @@
+#include "Debouncer.h"
+
+#ifdef ARDUINO
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#endif
+
+static volatile uint8_t debouncedLevels = 0xFF;   // Debounced level of every pin of port D
+static uint8_t counter0 = 0xFF;                   // Vertical counter, low bit of each pin
+static uint8_t counter1 = 0xFF;                   // Vertical counter, high bit of each pin
+static volatile uint8_t pressEvents = 0;          // Pins that went LOW since the last debouncer_takePresses()
+static volatile uint8_t releaseEvents = 0;        // Pins that went HIGH since the last debouncer_takeReleases()
+
+
+
+//=====================================================================================================================================================
+// Sampling, called by the timer interrupt
+//=====================================================================================================================================================
+// A counter is reloaded to 3 while its pin matches the debounced level and counts down while it differs. When it
+// wraps, the pin has read the new level DEBOUNCER_SAMPLES times in a row: its debounced level toggles.
+static void sample(uint8_t port) {
+  uint8_t changed = port ^ debouncedLevels;
+  counter0 = ~(counter0 & changed);
+  counter1 = counter0 ^ (counter1 & changed);
+  changed &= counter0 & counter1;
+
+  uint8_t levels = debouncedLevels ^ changed;
+  debouncedLevels = levels;
+  pressEvents |= changed & ~levels;
+  releaseEvents |= changed & levels;
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Main loop side
+//=====================================================================================================================================================
+uint8_t debouncer_level(uint8_t pin) {
+  return (debouncedLevels & debouncer_mask(pin)) ? HIGH : LOW;
+}
+
+// The interrupt may set a bit between the read and the clear: only the bits read are cleared
+uint8_t debouncer_takePresses() {
+  uint8_t events = pressEvents;
+  if (events != 0) {
+    uint8_t status = hal_disableInterrupts();
+    pressEvents &= ~events;
+    hal_restoreInterrupts(status);
+  }
+  return events;
+}
+
+uint8_t debouncer_takeReleases() {
+  uint8_t events = releaseEvents;
+  if (events != 0) {
+    uint8_t status = hal_disableInterrupts();
+    releaseEvents &= ~events;
+    hal_restoreInterrupts(status);
+  }
+  return events;
+}
+//=====================================================================================================================================================
+
+
+
+#ifdef ARDUINO
+//=====================================================================================================================================================
+// ATmega328P Timer2 backend
+//=====================================================================================================================================================
+void debouncer_begin() {
+  debouncedLevels = PIND;
+  // CTC mode, 16 MHz / 128 / 125 = 1 kHz
+  TCCR2A = _BV(WGM21);
+  TCCR2B = _BV(CS22) | _BV(CS20);
+  OCR2A = F_CPU / 128 / (1000000UL / DEBOUNCER_SAMPLE_PERIOD_US) - 1;
+  TCNT2 = 0;
+  TIMSK2 = _BV(OCIE2A);
+}
+
+ISR(TIMER2_COMPA_vect) {
+  // One read for the eight pins, all the inputs of the box are on port D
+  sample(PIND);
+}
+//=====================================================================================================================================================
+
+#else
+//=====================================================================================================================================================
+// Native backend: the simulated timer samples the simulated pins 0 to 7
+//=====================================================================================================================================================
+static uint8_t readPort() {
+  uint8_t port = 0;
+  for (uint8_t pin = 0; pin < 8; pin++) {
+    if (sim_pin(pin) == HIGH) {
+      port |= debouncer_mask(pin);
+    }
+  }
+  return port;
+}
+
+static void isr_sample() {
+  sample(readPort());
+}
+
+void debouncer_begin() {
+  debouncedLevels = readPort();
+  counter0 = 0xFF;
+  counter1 = 0xFF;
+  pressEvents = 0;
+  releaseEvents = 0;
+  sim_attachTimerInterrupt(DEBOUNCER_SAMPLE_PERIOD_US, isr_sample);
+}
+//=====================================================================================================================================================
+
+#endif
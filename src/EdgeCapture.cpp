@@ -0,0 +1,106 @@
+#include "EdgeCapture.h"
+#include "Pins.h"
+
+static EdgeEvent edgeBuffer[EDGE_BUFFER_SIZE];    // Ring buffer of captured edges
+static volatile uint8_t edgeHead = 0;             // Next slot written by the interrupts
+static volatile uint8_t edgeTail = 0;             // Next slot read by the main loop
+static volatile uint8_t edgeOverflows = 0;        // Edges lost because the buffer was full
+
+
+
+//=====================================================================================================================================================
+// Producer side, only called from the interrupts
+//=====================================================================================================================================================
+static void pushEdge(uint8_t channel, uint8_t level) {
+  unsigned long now = hal_micros();
+  uint8_t next = (edgeHead + 1) & (EDGE_BUFFER_SIZE - 1);
+  if (next == edgeTail) {
+    if (edgeOverflows < 255) {
+      edgeOverflows++;
+    }
+    return;
+  }
+  edgeBuffer[edgeHead].timestamp = now;
+  edgeBuffer[edgeHead].channel = channel;
+  edgeBuffer[edgeHead].level = level;
+  // Publish the slot only once it is complete
+  edgeHead = next;
+}
+
+static void isr_emergency() {
+  pushEdge(EDGE_EMERGENCY, EmergencyPin::read());
+}
+
+static void isr_wallSwitch() {
+  pushEdge(EDGE_WALL_SWITCH, WallSwitchPin::read());
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Consumer side, called from the main loop
+//=====================================================================================================================================================
+void edgeCapture_begin() {
+  hal_attachChangeInterrupt(pin_Emergency, isr_emergency);
+  hal_attachChangeInterrupt(pin_Wall_switch, isr_wallSwitch);
+}
+
+bool edgeCapture_pop(EdgeEvent& event) {
+  uint8_t tail = edgeTail;
+  if (tail == edgeHead) {
+    return false;
+  }
+  event = edgeBuffer[tail];
+  // Release the slot only after it has been copied
+  edgeTail = (tail + 1) & (EDGE_BUFFER_SIZE - 1);
+  return true;
+}
+
+uint8_t edgeCapture_overflows() {
+  return edgeOverflows;
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Timing statistics
+//=====================================================================================================================================================
+void edgeStats_reset(EdgeStats& stats, unsigned long reference) {
+  stats.reference = reference;
+  stats.burstStart = reference;
+  stats.burstEnd = reference;
+  stats.edges = 0;
+  stats.bounces = 0;
+}
+
+void edgeStats_add(EdgeStats& stats, const EdgeEvent& event) {
+  // Edges captured before the reset belong to the previous check
+  if ((long)(event.timestamp - stats.reference) < 0) {
+    return;
+  }
+  if (stats.edges > 0 && event.timestamp - stats.burstEnd < EDGE_BURST_GAP_US) {
+    // Same transition: the contact is still bouncing
+    if (stats.bounces < 255) {
+      stats.bounces++;
+    }
+  } else {
+    // First edge of a new transition
+    stats.burstStart = event.timestamp;
+    stats.bounces = 0;
+  }
+  stats.burstEnd = event.timestamp;
+  if (stats.edges < 255) {
+    stats.edges++;
+  }
+}
+
+unsigned long edgeStats_responseTime(const EdgeStats& stats) {
+  return stats.burstStart - stats.reference;
+}
+
+unsigned long edgeStats_settleTime(const EdgeStats& stats) {
+  return stats.burstEnd - stats.burstStart;
+}
+//=====================================================================================================================================================
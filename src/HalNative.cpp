@@ -0,0 +1,323 @@
+#ifndef ARDUINO
+
+#include "Hal.h"
+
+static uint8_t pinLevels[SIM_PIN_COUNT];          // Level of every pin
+static void (*pinInterrupts[SIM_PIN_COUNT])();    // Change interrupt attached to each pin
+static void (*portChangeInterrupt)() = nullptr;   // Pin-change interrupt of D0..D7, like PCINT2
+static unsigned long clockMicros = 0;             // Virtual clock
+static void (*timerInterrupts[SIM_TIMER_COUNT])();        // Periodic interrupts
+static unsigned long timerPeriods[SIM_TIMER_COUNT];
+static unsigned long timerDeadlines[SIM_TIMER_COUNT];     // Virtual time of the next call of each interrupt
+static void (*wakeHook)() = nullptr;              // Called before each interrupt, ends the sleep of the CPU
+static uint8_t i2cAddress = 0;                    // Device addressed by the running transaction
+static bool i2cAcknowledge = true;                // The backpack answers its address
+static unsigned long i2cTransactions = 0;
+static unsigned long i2cBytes = 0;
+static bool busTiming = false;                    // I2C bytes take their time on the virtual clock
+static uint8_t pcfPort = 0;                       // Last byte written to the PCF8574
+static bool lcdFourBit = false;                   // HD44780 interface width, 8 bits after power-up
+static bool lcdHighNibble = false;                // The high nibble of a 4-bit transfer has been received
+static uint8_t lcdNibble = 0;                     // High nibble waiting for the low one
+static uint8_t lcdAddress = 0;                    // HD44780 DDRAM address counter
+static char lcdCells[4][21];                      // LCD content, one terminated string per row
+static unsigned long lcdBytes = 0;
+
+
+
+//=====================================================================================================================================================
+// Virtual clock
+//=====================================================================================================================================================
+// Every advance of the clock, including the delays of the firmware, runs the timer interrupts that fall due
+// in order, with the clock set to their deadline like on the real chip.
+static void advanceClock(unsigned long microseconds) {
+  unsigned long end = clockMicros + microseconds;
+  for (;;) {
+    int8_t next = -1;
+    for (uint8_t timer = 0; timer < SIM_TIMER_COUNT; timer++) {
+      if (timerInterrupts[timer] != nullptr && (long)(timerDeadlines[timer] - end) <= 0 &&
+          (next < 0 || (long)(timerDeadlines[timer] - timerDeadlines[next]) < 0)) {
+        next = timer;
+      }
+    }
+    if (next < 0) {
+      break;
+    }
+    clockMicros = timerDeadlines[next];
+    timerDeadlines[next] += timerPeriods[next];
+    if (wakeHook != nullptr) {
+      wakeHook();
+    }
+    timerInterrupts[next]();
+  }
+  clockMicros = end;
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Print
+//=====================================================================================================================================================
+size_t Print::write(const uint8_t* buffer, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    write(buffer[i]);
+  }
+  return size;
+}
+
+size_t Print::print(const char* text) {
+  return write((const uint8_t*)text, strlen(text));
+}
+
+size_t Print::print(char character) {
+  return write((uint8_t)character);
+}
+
+size_t Print::print(unsigned long value) {
+  char digits[11];
+  snprintf(digits, sizeof(digits), "%lu", value);
+  return print(digits);
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Simulated PCF8574 backpack (P0 = RS, P2 = EN, P4..P7 = D4..D7) and HD44780 controller
+//=====================================================================================================================================================
+static void clearLcd() {
+  for (uint8_t row = 0; row < 4; row++) {
+    memset(lcdCells[row], ' ', 20);
+    lcdCells[row][20] = '\0';
+  }
+  lcdAddress = 0;
+}
+
+// DDRAM of a 20x4: row 0 at 0x00, row 2 right after it at 0x14, rows 1 and 3 at 0x40 and 0x54
+static void writeLcdCell(uint8_t character) {
+  uint8_t row = lcdAddress >= 0x40 ? 1 : 0;
+  uint8_t column = lcdAddress - row * 0x40;
+  if (column >= 20) {
+    row += 2;
+    column -= 20;
+  }
+  if (column < 20) {
+    lcdCells[row][column] = character;
+  }
+  lcdAddress = (lcdAddress + 1) & 0x7F;
+}
+
+static void executeLcd(uint8_t value, bool character) {
+  lcdBytes++;
+  if (character) {
+    writeLcdCell(value);
+  } else if (value & 0x80) {
+    lcdAddress = value & 0x7F;
+  } else if (value & 0x40) {
+    // CGRAM address, the custom characters are not simulated
+  } else if (value & 0x20) {
+    lcdFourBit = (value & 0x10) == 0;
+    lcdHighNibble = false;
+  } else if (value & 0x1C) {
+    // Shift, display control and entry mode: the firmware only uses the defaults
+  } else if (value & 0x02) {
+    lcdAddress = 0;
+  } else if (value & 0x01) {
+    clearLcd();
+  }
+}
+
+// The HD44780 latches D4..D7 and RS on the falling edge of EN
+static void writePcf(uint8_t port) {
+  if ((pcfPort & 0x04) && !(port & 0x04)) {
+    uint8_t nibble = pcfPort >> 4;
+    bool character = pcfPort & 0x01;
+    if (!lcdFourBit) {
+      executeLcd(nibble << 4, character);
+    } else if (!lcdHighNibble) {
+      lcdNibble = nibble;
+      lcdHighNibble = true;
+    } else {
+      lcdHighNibble = false;
+      executeLcd(lcdNibble << 4 | nibble, character);
+    }
+  }
+  pcfPort = port;
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// HAL functions
+//=====================================================================================================================================================
+uint8_t hal_digitalRead(uint8_t pin) {
+  return pin < SIM_PIN_COUNT ? pinLevels[pin] : LOW;
+}
+
+void hal_digitalWrite(uint8_t pin, uint8_t level) {
+  if (pin < SIM_PIN_COUNT) {
+    pinLevels[pin] = level;
+  }
+}
+
+void hal_pinMode(uint8_t pin, uint8_t mode) {
+  // Outputs start LOW like on the ATmega, inputs keep the level driven by the test (HIGH through the pull-up)
+  if (mode == OUTPUT && pin < SIM_PIN_COUNT) {
+    pinLevels[pin] = LOW;
+  }
+}
+
+unsigned long hal_millis() {
+  return clockMicros / 1000;
+}
+
+unsigned long hal_micros() {
+  return clockMicros;
+}
+
+void hal_delay(unsigned long milliseconds) {
+  advanceClock(milliseconds * 1000);
+}
+
+void hal_attachChangeInterrupt(uint8_t pin, void (*isr)()) {
+  if (pin < SIM_PIN_COUNT) {
+    pinInterrupts[pin] = isr;
+  }
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Simulation control
+//=====================================================================================================================================================
+void sim_reset() {
+  memset(pinLevels, HIGH, sizeof(pinLevels));
+  memset(pinInterrupts, 0, sizeof(pinInterrupts));
+  portChangeInterrupt = nullptr;
+  memset(timerInterrupts, 0, sizeof(timerInterrupts));
+  wakeHook = nullptr;
+  clockMicros = 0;
+  busTiming = false;
+  pcfPort = 0;
+  lcdFourBit = false;
+  lcdHighNibble = false;
+  clearLcd();
+  lcdBytes = 0;
+  i2cTransactions = 0;
+  i2cBytes = 0;
+  i2cAcknowledge = true;
+}
+
+void sim_setPin(uint8_t pin, uint8_t level) {
+  if (pin >= SIM_PIN_COUNT || pinLevels[pin] == level) {
+    return;
+  }
+  pinLevels[pin] = level;
+  if (wakeHook != nullptr && (pinInterrupts[pin] != nullptr || (pin < 8 && portChangeInterrupt != nullptr))) {
+    wakeHook();
+  }
+  if (pinInterrupts[pin] != nullptr) {
+    pinInterrupts[pin]();
+  }
+  if (pin < 8 && portChangeInterrupt != nullptr) {
+    portChangeInterrupt();
+  }
+}
+
+void sim_attachPortChangeInterrupt(void (*isr)()) {
+  portChangeInterrupt = isr;
+}
+
+uint8_t sim_pin(uint8_t pin) {
+  return hal_digitalRead(pin);
+}
+
+void sim_advanceMicros(unsigned long microseconds) {
+  advanceClock(microseconds);
+}
+
+void sim_detachTimerInterrupt(void (*isr)()) {
+  for (uint8_t timer = 0; timer < SIM_TIMER_COUNT; timer++) {
+    if (timerInterrupts[timer] == isr) {
+      timerInterrupts[timer] = nullptr;
+    }
+  }
+}
+
+uint8_t sim_timerInterrupts() {
+  uint8_t count = 0;
+  for (uint8_t timer = 0; timer < SIM_TIMER_COUNT; timer++) {
+    if (timerInterrupts[timer] != nullptr) {
+      count++;
+    }
+  }
+  return count;
+}
+
+void sim_attachWakeHook(void (*hook)()) {
+  wakeHook = hook;
+}
+
+void sim_attachTimerInterrupt(unsigned long periodMicros, void (*isr)()) {
+  // Attaching an interrupt again restarts its period
+  sim_detachTimerInterrupt(isr);
+  for (uint8_t timer = 0; timer < SIM_TIMER_COUNT; timer++) {
+    if (timerInterrupts[timer] == nullptr) {
+      timerInterrupts[timer] = isr;
+      timerPeriods[timer] = periodMicros;
+      timerDeadlines[timer] = clockMicros + periodMicros;
+      return;
+    }
+  }
+}
+
+bool sim_i2cStart(uint8_t address) {
+  i2cTransactions++;
+  i2cAddress = address;
+  return address == SIM_LCD_I2C_ADDRESS && i2cAcknowledge;
+}
+
+void sim_i2cSetAcknowledge(bool acknowledge) {
+  i2cAcknowledge = acknowledge;
+}
+
+void sim_i2cWrite(uint8_t data) {
+  i2cBytes++;
+  if (i2cAddress == SIM_LCD_I2C_ADDRESS) {
+    writePcf(data);
+  }
+}
+
+void sim_i2cStop() {
+  i2cAddress = 0;
+}
+
+const char* sim_lcdRow(uint8_t row) {
+  return lcdCells[row];
+}
+
+unsigned long sim_lcdBytes() {
+  return lcdBytes;
+}
+
+unsigned long sim_i2cTransactions() {
+  return i2cTransactions;
+}
+
+unsigned long sim_i2cBytes() {
+  return i2cBytes;
+}
+
+void sim_enableBusTiming(bool enabled) {
+  busTiming = enabled;
+}
+
+bool sim_busTimingEnabled() {
+  return busTiming;
+}
+//=====================================================================================================================================================
+
+#endif
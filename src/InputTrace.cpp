@@ -0,0 +1,153 @@
+#include "InputTrace.h"
+
+#ifdef ARDUINO
+#include <avr/io.h>
+#endif
+
+static void enablePins(bool enabled);
+static uint8_t readPins();
+
+static InputTransition buffer[INPUT_TRACE_BUFFER_SIZE];   // Ring buffer of captured transitions
+static volatile uint8_t head = 0;                 // Next slot written by the interrupt
+static volatile uint8_t tail = 0;                 // Next slot read by the main loop
+static volatile bool recording = false;
+static unsigned long startTime = 0;
+static uint8_t startLevels = 0;
+static uint8_t lastLevels = 0;                    // Levels of the last captured transition
+static volatile uint16_t transitions = 0;
+static volatile uint8_t overflows = 0;
+
+
+
+//=====================================================================================================================================================
+// Producer side, called by the pin-change interrupt
+//=====================================================================================================================================================
+// Changes of the pins shared with the interrupt but not recorded (round trip only) are filtered out by the comparison
+void inputTrace_portChanged() {
+  if (!recording) {
+    return;
+  }
+  uint8_t levels = readPins();
+  if (levels == lastLevels) {
+    return;
+  }
+  lastLevels = levels;
+  transitions++;
+  uint8_t next = head + 1 < INPUT_TRACE_BUFFER_SIZE ? head + 1 : 0;
+  if (next == tail) {
+    if (overflows < 255) {
+      overflows++;
+    }
+    return;
+  }
+  buffer[head].time = hal_micros() - startTime;
+  buffer[head].levels = levels;
+  // Publish the slot only once it is complete
+  head = next;
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Main loop side
+//=====================================================================================================================================================
+void inputTrace_start() {
+  uint8_t status = hal_disableInterrupts();
+  head = 0;
+  tail = 0;
+  transitions = 0;
+  overflows = 0;
+  startTime = hal_micros();
+  startLevels = readPins();
+  lastLevels = startLevels;
+  recording = true;
+  enablePins(true);
+  hal_restoreInterrupts(status);
+}
+
+void inputTrace_stop() {
+  uint8_t status = hal_disableInterrupts();
+  recording = false;
+  enablePins(false);
+  hal_restoreInterrupts(status);
+}
+
+bool inputTrace_recording() {
+  return recording;
+}
+
+unsigned long inputTrace_startTime() {
+  return startTime;
+}
+
+uint8_t inputTrace_startLevels() {
+  return startLevels;
+}
+
+bool inputTrace_take(InputTransition& transition) {
+  uint8_t current = tail;
+  if (current == head) {
+    return false;
+  }
+  transition = buffer[current];
+  // Release the slot only after it has been copied
+  tail = current + 1 < INPUT_TRACE_BUFFER_SIZE ? current + 1 : 0;
+  return true;
+}
+
+bool inputTrace_pending() {
+  return tail != head;
+}
+
+uint16_t inputTrace_transitions() {
+  uint8_t status = hal_disableInterrupts();
+  uint16_t count = transitions;
+  hal_restoreInterrupts(status);
+  return count;
+}
+
+uint8_t inputTrace_overflows() {
+  return overflows;
+}
+//=====================================================================================================================================================
+
+
+
+#ifdef ARDUINO
+//=====================================================================================================================================================
+// ATmega328P backend: the recorded pins are PCINT18 to PCINT23, bit n of PCMSK2 is pin Dn
+//=====================================================================================================================================================
+static void enablePins(bool enabled) {
+  if (enabled) {
+    PCMSK2 |= INPUT_TRACE_PINS;
+  } else {
+    // The round-trip measurement keeps its pins
+    PCMSK2 = (PCMSK2 & ~INPUT_TRACE_PINS) | _BV(PCINT21) | _BV(PCINT22);
+  }
+}
+
+static uint8_t readPins() {
+  return PIND & INPUT_TRACE_PINS;
+}
+//=====================================================================================================================================================
+
+#else
+//=====================================================================================================================================================
+// Native backend: the simulated port D interrupt runs on every change of D0..D7
+//=====================================================================================================================================================
+static void enablePins(bool) {
+}
+
+static uint8_t readPins() {
+  uint8_t levels = 0;
+  for (uint8_t pin = 0; pin < 8; pin++) {
+    if (sim_pin(pin) == HIGH) {
+      levels |= 1 << pin;
+    }
+  }
+  return levels & INPUT_TRACE_PINS;
+}
+//=====================================================================================================================================================
+
+#endif
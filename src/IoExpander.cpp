@@ -0,0 +1,129 @@
+#include "IoExpander.h"
+#include "Pins.h"
+
+#include <string.h>
+
+#ifdef ARDUINO
+#include <avr/io.h>
+#endif
+
+static uint8_t outputs[EXPANDER_BYTES];            // Levels to latch at the next update
+static uint8_t lastRead[EXPANDER_BYTES];           // Inputs read by the previous update
+static uint8_t levels[EXPANDER_BYTES];             // Debounced inputs
+
+static void setupHardware();
+static void transfer(uint8_t* inputs);
+
+
+
+//=====================================================================================================================================================
+// Slot layout: slot n is nibble n % 2 of byte n / 2, the byte nearest the Uno in both chains is byte 0
+//=====================================================================================================================================================
+static uint8_t lineMask(uint8_t slot, uint8_t line) {
+  return 1 << ((slot % 2) * EXPANDER_SLOT_LINES + line);
+}
+
+void expander_begin() {
+  memset(outputs, 0, sizeof(outputs));
+  setupHardware();
+  transfer(lastRead);
+  memcpy(levels, lastRead, sizeof(levels));
+}
+
+// A bit takes the level read when it is the same as on the previous update
+void expander_update() {
+  uint8_t inputs[EXPANDER_BYTES];
+  transfer(inputs);
+  for (uint8_t index = 0; index < EXPANDER_BYTES; index++) {
+    uint8_t steady = ~(inputs[index] ^ lastRead[index]);
+    levels[index] = (levels[index] & ~steady) | (inputs[index] & steady);
+    lastRead[index] = inputs[index];
+  }
+}
+
+uint8_t expander_level(uint8_t slot, uint8_t line) {
+  return (levels[slot / 2] & lineMask(slot, line)) ? HIGH : LOW;
+}
+
+void expander_write(uint8_t slot, uint8_t line, uint8_t level) {
+  if (level == LOW) {
+    outputs[slot / 2] &= ~lineMask(slot, line);
+  } else {
+    outputs[slot / 2] |= lineMask(slot, line);
+  }
+}
+
+uint8_t expander_output(uint8_t slot, uint8_t line) {
+  return (outputs[slot / 2] & lineMask(slot, line)) ? HIGH : LOW;
+}
+//=====================================================================================================================================================
+
+
+
+#ifdef ARDUINO
+//=====================================================================================================================================================
+// ATmega328P SPI backend: MOSI (D11) to the 74HC595 chain, MISO (D12) from the 74HC165 chain, SCK (D13) to both
+//=====================================================================================================================================================
+static void setupHardware() {
+  ExpanderLoadPin::high();
+  ExpanderLoadPin::setMode(OUTPUT);
+  ExpanderLatchPin::low();
+  ExpanderLatchPin::setMode(OUTPUT);
+  // SS (D10, the latch) is an output, so the SPI stays master. MOSI and SCK are outputs, MISO an input
+  DDRB |= _BV(DDB3) | _BV(DDB5);
+  DDRB &= ~_BV(DDB4);
+  // Master, mode 0, MSB first, 16 MHz / 4
+  SPCR = _BV(SPE) | _BV(MSTR);
+  SPSR = 0;
+}
+
+// The transfer polls SPIF: at 4 MHz a byte takes 2 us, less than an interrupt entry and exit.
+static void transfer(uint8_t* inputs) {
+  // SH/LD low copies the input pins into the 74HC165 registers, its first bit is on MISO when it goes back high
+  ExpanderLoadPin::low();
+  ExpanderLoadPin::high();
+  // The first byte shifted out ends in the farthest 74HC595: the outputs leave from the last byte
+  for (uint8_t index = 0; index < EXPANDER_BYTES; index++) {
+    SPDR = outputs[EXPANDER_BYTES - 1 - index];
+    while (!(SPSR & _BV(SPIF))) {
+    }
+    inputs[index] = SPDR;
+  }
+  // RCLK rising edge copies the shift registers to the 74HC595 pins
+  ExpanderLatchPin::high();
+  ExpanderLatchPin::low();
+}
+//=====================================================================================================================================================
+
+#else
+//=====================================================================================================================================================
+// Native backend: the chains are the simulated input and output bytes
+//=====================================================================================================================================================
+static uint8_t simInputs[EXPANDER_BYTES];
+static uint8_t simOutputs[EXPANDER_BYTES];
+
+// The inputs start released, like the pull-ups of the simulated pins
+static void setupHardware() {
+  memset(simInputs, 0xFF, sizeof(simInputs));
+  memset(simOutputs, 0, sizeof(simOutputs));
+}
+
+static void transfer(uint8_t* inputs) {
+  memcpy(inputs, simInputs, EXPANDER_BYTES);
+  memcpy(simOutputs, outputs, EXPANDER_BYTES);
+}
+
+void sim_expanderSetInput(uint8_t slot, uint8_t line, uint8_t level) {
+  if (level == LOW) {
+    simInputs[slot / 2] &= ~lineMask(slot, line);
+  } else {
+    simInputs[slot / 2] |= lineMask(slot, line);
+  }
+}
+
+uint8_t sim_expanderOutput(uint8_t slot, uint8_t line) {
+  return (simOutputs[slot / 2] & lineMask(slot, line)) ? HIGH : LOW;
+}
+//=====================================================================================================================================================
+
+#endif
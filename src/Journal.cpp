@@ -0,0 +1,233 @@
+#include "Journal.h"
+
+#ifdef ARDUINO
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#endif
+
+static_assert(sizeof(JournalRecord) == JOURNAL_RECORD_SIZE, "JournalRecord must match the EEPROM slot size");
+
+static uint8_t nextSlot = 0;                      // Slot of the next record, the oldest one once the EEPROM is full
+static uint8_t recordCount = 0;                   // Valid records in the EEPROM
+static uint16_t lastRun = 0xFFFF;                 // Run counter of the newest record
+static uint8_t pending[JOURNAL_RECORD_SIZE];      // Record being written by the interrupt
+static uint16_t pendingAddress;                   // EEPROM address of its first byte
+static volatile uint8_t pendingIndex = JOURNAL_RECORD_SIZE;   // Next byte to write, JOURNAL_RECORD_SIZE = all started
+static volatile bool writing = false;             // Cleared by the interrupt once the last byte is in the EEPROM
+
+static uint8_t readByte(uint16_t address);
+static void startWriting();
+
+
+
+//=====================================================================================================================================================
+// Records
+//=====================================================================================================================================================
+static uint8_t crc8(const uint8_t* data, uint8_t length) {
+  uint8_t crc = 0;
+  for (uint8_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+static bool readSlot(uint8_t slot, JournalRecord& record) {
+  uint8_t* bytes = (uint8_t*)&record;
+  for (uint8_t i = 0; i < JOURNAL_RECORD_SIZE; i++) {
+    bytes[i] = readByte(slot * JOURNAL_RECORD_SIZE + i);
+  }
+  // Erased EEPROM reads 0xFF: bit 15 of the verdicts rejects it whatever its checksum
+  return (record.verdicts & 0x8000) == 0 && record.checksum == crc8(bytes, JOURNAL_RECORD_SIZE - 1);
+}
+
+void journalRecord_clear(JournalRecord& record, uint16_t run) {
+  memset(&record, 0, sizeof(record));
+  record.run = run;
+  record.verdicts = 0x7FFF;
+  record.emergencyResponse = JOURNAL_TIME_NONE;
+  record.emergencySettle = JOURNAL_TIME_NONE;
+  record.wallSwitchResponse = JOURNAL_TIME_NONE;
+  record.wallSwitchSettle = JOURNAL_TIME_NONE;
+  record.roundTrip = JOURNAL_TIME_NONE;
+}
+
+void journalRecord_setVerdict(JournalRecord& record, uint8_t sequence, uint8_t verdict) {
+  uint8_t shift = sequence * JOURNAL_VERDICT_BITS;
+  record.verdicts = (record.verdicts & ~(JOURNAL_VERDICT_NONE << shift)) | ((verdict & JOURNAL_VERDICT_NONE) << shift);
+}
+
+uint8_t journalRecord_verdict(const JournalRecord& record, uint8_t sequence) {
+  return (record.verdicts >> (sequence * JOURNAL_VERDICT_BITS)) & JOURNAL_VERDICT_NONE;
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Journal
+//=====================================================================================================================================================
+// The records are written in consecutive slots with consecutive run counters: the newest one is the valid record
+// with the highest counter, compared modulo 2^16 so that the counter can wrap. A record torn by a power cut fails
+// its checksum and is simply skipped.
+void journal_begin() {
+  JournalRecord record;
+  int16_t newestSlot = -1;
+  recordCount = 0;
+  lastRun = 0xFFFF;
+
+  for (uint8_t slot = 0; slot < JOURNAL_CAPACITY; slot++) {
+    if (!readSlot(slot, record)) {
+      continue;
+    }
+    recordCount++;
+    if (newestSlot < 0 || (int16_t)(record.run - lastRun) > 0) {
+      newestSlot = slot;
+      lastRun = record.run;
+    }
+  }
+  nextSlot = (newestSlot + 1) % JOURNAL_CAPACITY;
+}
+
+uint16_t journal_nextRun() {
+  return lastRun + 1;
+}
+
+uint8_t journal_count() {
+  return recordCount;
+}
+
+// pendingIndex reaches the end as soon as the last byte write starts, the EEPROM is busy for 3.4 ms more
+bool journal_busy() {
+  return writing;
+}
+
+bool journal_append(JournalRecord& record) {
+  if (journal_busy()) {
+    return false;
+  }
+  JournalRecord overwritten;
+  if (!readSlot(nextSlot, overwritten)) {
+    recordCount++;
+  }
+  record.checksum = crc8((const uint8_t*)&record, JOURNAL_RECORD_SIZE - 1);
+  memcpy(pending, &record, JOURNAL_RECORD_SIZE);
+  pendingAddress = nextSlot * JOURNAL_RECORD_SIZE;
+  nextSlot = (nextSlot + 1) % JOURNAL_CAPACITY;
+  lastRun = record.run;
+
+  pendingIndex = 0;
+  writing = true;
+  startWriting();
+  return true;
+}
+
+bool journal_read(uint8_t index, JournalRecord& record) {
+  if (index >= JOURNAL_CAPACITY || journal_busy()) {
+    return false;
+  }
+  return readSlot((nextSlot + index) % JOURNAL_CAPACITY, record);
+}
+
+// Called each time the EEPROM can take a byte: writes the next byte that differs, returns false when the record is done
+static bool nextByte(uint16_t& address, uint8_t& data) {
+  while (pendingIndex < JOURNAL_RECORD_SIZE) {
+    uint8_t index = pendingIndex++;
+    address = pendingAddress + index;
+    data = pending[index];
+    if (readByte(address) != data) {
+      return true;
+    }
+  }
+  return false;
+}
+//=====================================================================================================================================================
+
+
+
+#ifdef ARDUINO
+//=====================================================================================================================================================
+// ATmega328P backend
+//=====================================================================================================================================================
+static uint8_t readByte(uint16_t address) {
+  // The EEPROM can neither be read nor addressed while a write is in progress
+  while (EECR & _BV(EEPE)) {
+  }
+  EEAR = address;
+  EECR |= _BV(EERE);
+  return EEDR;
+}
+
+static void startWriting() {
+  EECR |= _BV(EERIE);
+}
+
+// Runs when EEPE is clear, after the previous byte is written
+ISR(EE_READY_vect) {
+  uint16_t address;
+  uint8_t data;
+  if (!nextByte(address, data)) {
+    EECR &= ~_BV(EERIE);
+    writing = false;
+    return;
+  }
+  // Erase and write in one 3.4 ms operation, EEPE must be set within four cycles of EEMPE
+  EEAR = address;
+  EEDR = data;
+  EECR = _BV(EERIE) | _BV(EEMPE);
+  EECR = _BV(EERIE) | _BV(EEMPE) | _BV(EEPE);
+}
+//=====================================================================================================================================================
+
+#else
+//=====================================================================================================================================================
+// Native backend: a byte write takes 3.4 ms of virtual time, like on the chip, the byte is only in the EEPROM at the
+// end of the write
+//=====================================================================================================================================================
+const unsigned long SIM_EEPROM_WRITE_US = 3400;
+
+static uint8_t eeprom[JOURNAL_EEPROM_SIZE];
+static bool eepromInitialized = false;
+static bool byteWriting = false;                  // A byte write is in progress
+static uint16_t byteAddress;                      // and the byte it writes
+static uint8_t byteData;
+
+uint8_t* sim_eeprom() {
+  if (!eepromInitialized) {
+    memset(eeprom, 0xFF, sizeof(eeprom));
+    eepromInitialized = true;
+  }
+  return eeprom;
+}
+
+static uint8_t readByte(uint16_t address) {
+  return sim_eeprom()[address];
+}
+
+static void isr_eepromReady() {
+  uint16_t address;
+  uint8_t data;
+  if (byteWriting) {
+    sim_eeprom()[byteAddress] = byteData;
+    byteWriting = false;
+  }
+  // Like EERIE on the chip, the interrupt is off once the last byte is written
+  if (!writing || !nextByte(address, data)) {
+    writing = false;
+    sim_detachTimerInterrupt(isr_eepromReady);
+    return;
+  }
+  byteAddress = address;
+  byteData = data;
+  byteWriting = true;
+}
+
+static void startWriting() {
+  writing = true;
+  sim_attachTimerInterrupt(SIM_EEPROM_WRITE_US, isr_eepromReady);
+}
+//=====================================================================================================================================================
+
+#endif
@@ -0,0 +1,94 @@
+#include "LcdFrameBuffer.h"
+
+LcdFrameBuffer::LcdFrameBuffer()
+  : cursorColumn(0), cursorRow(0), frameBytes(0), sentBytes(0), busErrors(0) {
+}
+
+
+
+//=====================================================================================================================================================
+// Drawing into the RAM copy
+//=====================================================================================================================================================
+void LcdFrameBuffer::begin() {
+  memset(shown, ' ', sizeof(shown));
+  clear();
+  frameBytes = 0;
+  sentBytes = 0;
+  busErrors = lcd_busErrors();
+}
+
+void LcdFrameBuffer::clear() {
+  memset(frame, ' ', sizeof(frame));
+  cursorColumn = 0;
+  cursorRow = 0;
+}
+
+void LcdFrameBuffer::setCursor(uint8_t column, uint8_t row) {
+  cursorColumn = column;
+  cursorRow = row;
+}
+
+size_t LcdFrameBuffer::write(uint8_t character) {
+  // Characters past the end of a row are dropped, the rows of a 20x4 LCD are not contiguous anyway
+  if (cursorRow >= LCD_ROWS || cursorColumn >= LCD_COLUMNS) {
+    return 0;
+  }
+  frame[cursorRow][cursorColumn] = character;
+  cursorColumn++;
+  return 1;
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Transfer of the differences
+//=====================================================================================================================================================
+// The LCD moves its cursor after each character, so a run of changed cells needs one setCursor() only.
+// A single unchanged cell between two runs is resent: it costs the same byte as the setCursor() it avoids.
+// A changed cell needs at most two queue entries, the transfer stops when they are not free.
+uint16_t LcdFrameBuffer::sendChanges() {
+  uint16_t bytes = 0;
+  bool queueFull = false;                         // The remaining cells wait for the next call
+
+  // What the LCD shows is unknown after a dropped transaction: every cell is marked as different
+  uint8_t errors = lcd_busErrors();
+  if (errors != busErrors) {
+    busErrors = errors;
+    for (uint8_t row = 0; row < LCD_ROWS; row++) {
+      for (uint8_t column = 0; column < LCD_COLUMNS; column++) {
+        shown[row][column] = ~frame[row][column];
+      }
+    }
+  }
+
+  for (uint8_t row = 0; row < LCD_ROWS && !queueFull; row++) {
+    int8_t lcdColumn = -1;                        // Column of the LCD cursor on this row, -1 = not on this row
+    for (uint8_t column = 0; column < LCD_COLUMNS; column++) {
+      if (frame[row][column] == shown[row][column]) {
+        continue;
+      }
+      if (lcd_queueFree() < 2) {
+        queueFull = true;
+        break;
+      }
+      if (column > 0 && lcdColumn == column - 1) {
+        // One unchanged cell behind the cursor: write it again instead of moving the cursor
+        lcd_write(frame[row][column - 1]);
+        bytes++;
+      } else if (lcdColumn != column) {
+        lcd_setCursor(column, row);
+        bytes++;
+      }
+      lcd_write(frame[row][column]);
+      shown[row][column] = frame[row][column];
+      bytes++;
+      lcdColumn = column + 1;
+    }
+  }
+
+  frameBytes = bytes;
+  sentBytes += bytes;
+  return bytes;
+}
+//=====================================================================================================================================================
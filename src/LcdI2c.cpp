@@ -0,0 +1,260 @@
+#include "LcdI2c.h"
+
+#ifdef ARDUINO
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <util/twi.h>
+#endif
+
+// Kinds of queue entries, in the high byte of an entry
+const uint16_t ENTRY_COMMAND = 0x0000;            // Instruction byte, RS low
+const uint16_t ENTRY_DATA = 0x0100;               // Character byte, RS high
+const uint16_t ENTRY_NIBBLE = 0x0200;             // High nibble alone, used while the HD44780 is still in 8-bit mode
+const uint16_t ENTRY_PORT = 0x0400;               // Plain PCF8574 write, applies the backlight
+
+// HD44780 instructions
+const uint8_t LCD_CLEAR = 0x01;
+const uint8_t LCD_ENTRY_LEFT = 0x06;              // Cursor moves right after each character, no display shift
+const uint8_t LCD_DISPLAY_ON = 0x0C;              // Display on, cursor and blink off
+const uint8_t LCD_FUNCTION_4BIT_2LINE = 0x28;     // 4-bit bus, 2-line addressing (a 20x4 is two folded lines), 5x8 font
+const uint8_t LCD_FUNCTION_8BIT = 0x30;
+const uint8_t LCD_FUNCTION_4BIT = 0x20;
+const uint8_t LCD_SET_ADDRESS = 0x80;
+const uint8_t LCD_ROW_ADDRESSES[4] = { 0x00, 0x40, 0x14, 0x54 };
+const uint8_t LCD_CLEAR_MS = 2;                   // The clear instruction takes 1.52 ms
+
+static void startTransfer();
+static void waitForBus();
+
+static uint8_t busAddress = LCD_I2C_ADDRESS;
+static uint16_t queue[LCD_QUEUE_SIZE];            // LCD bytes waiting for the bus, with their kind
+static volatile uint8_t queueHead = 0;            // Next slot written by the main loop
+static volatile uint8_t queueTail = 0;            // Next entry taken by the interrupt
+static volatile bool transferring = false;        // An I2C transaction is running
+static volatile uint8_t busErrors = 0;
+static volatile uint8_t backlight = LCD_PORT_BACKLIGHT;
+static uint8_t portBytes[6];                      // PCF8574 writes of the entry being sent, used by the interrupt only
+static uint8_t portCount = 0;
+static uint8_t portIndex = 0;
+
+
+
+//=====================================================================================================================================================
+// Queue side shared by both backends
+//=====================================================================================================================================================
+uint8_t lcd_queueFree() {
+  return (queueTail - queueHead - 1) & (LCD_QUEUE_SIZE - 1);
+}
+
+bool lcd_idle() {
+  return !transferring;
+}
+
+uint8_t lcd_busErrors() {
+  return busErrors;
+}
+
+static void queueEntry(uint16_t entry) {
+  while (lcd_queueFree() == 0) {
+    waitForBus();
+  }
+  queue[queueHead] = entry;
+  queueHead = (queueHead + 1) & (LCD_QUEUE_SIZE - 1);
+  startTransfer();
+}
+
+static void waitIdle() {
+  while (!lcd_idle()) {
+    waitForBus();
+  }
+}
+
+void lcd_setCursor(uint8_t column, uint8_t row) {
+  queueEntry(ENTRY_COMMAND | (uint8_t)(LCD_SET_ADDRESS | (LCD_ROW_ADDRESSES[row & 3] + column)));
+}
+
+void lcd_write(uint8_t character) {
+  queueEntry(ENTRY_DATA | character);
+}
+
+void lcd_setBacklight(bool on) {
+  backlight = on ? LCD_PORT_BACKLIGHT : 0;
+  queueEntry(ENTRY_PORT);
+}
+
+void lcd_clear() {
+  queueEntry(ENTRY_COMMAND | LCD_CLEAR);
+  waitIdle();
+  hal_delay(LCD_CLEAR_MS);
+}
+
+// Called by the interrupt: next byte for the PCF8574, -1 once the queue is empty. A nibble is written three times,
+// with EN low, high and low again, so D4..D7 and RS are stable around both edges of EN.
+static int16_t nextPortByte() {
+  if (portIndex == portCount) {
+    uint8_t tail = queueTail;
+    if (tail == queueHead) {
+      return -1;
+    }
+    uint16_t entry = queue[tail];
+    queueTail = (tail + 1) & (LCD_QUEUE_SIZE - 1);
+
+    uint8_t control = backlight | ((entry & ENTRY_DATA) ? LCD_PORT_RS : 0);
+    portCount = 0;
+    portIndex = 0;
+    if (entry & ENTRY_PORT) {
+      portBytes[portCount++] = control;
+    } else {
+      for (uint8_t nibble = 0; nibble < ((entry & ENTRY_NIBBLE) ? 1 : 2); nibble++) {
+        uint8_t value = (nibble == 0 ? entry & 0xF0 : (entry << 4) & 0xF0) | control;
+        portBytes[portCount++] = value;
+        portBytes[portCount++] = value | LCD_PORT_EN;
+        portBytes[portCount++] = value;
+      }
+    }
+  }
+  return portBytes[portIndex++];
+}
+
+// Drops what the interrupt could not send
+static void dropQueue() {
+  queueTail = queueHead;
+  portIndex = portCount;
+  busErrors++;
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Display initialization, HD44780 datasheet figure 24: three 8-bit function sets, then the switch to 4-bit mode
+//=====================================================================================================================================================
+static void beginBus();
+
+void lcd_begin(uint8_t address) {
+  busAddress = address;
+  queueHead = 0;
+  queueTail = 0;
+  portIndex = portCount;
+  transferring = false;
+  beginBus();
+
+  hal_delay(50);                                  // More than 40 ms after the supply reaches 2.7 V
+  queueEntry(ENTRY_PORT);                         // All port bits low except the backlight
+  queueEntry(ENTRY_NIBBLE | LCD_FUNCTION_8BIT);
+  waitIdle();
+  hal_delay(5);
+  queueEntry(ENTRY_NIBBLE | LCD_FUNCTION_8BIT);
+  waitIdle();
+  hal_delay(1);
+  queueEntry(ENTRY_NIBBLE | LCD_FUNCTION_8BIT);
+  queueEntry(ENTRY_NIBBLE | LCD_FUNCTION_4BIT);
+  queueEntry(ENTRY_COMMAND | LCD_FUNCTION_4BIT_2LINE);
+  queueEntry(ENTRY_COMMAND | LCD_DISPLAY_ON);
+  queueEntry(ENTRY_COMMAND | LCD_ENTRY_LEFT);
+  lcd_clear();
+}
+//=====================================================================================================================================================
+
+
+
+#ifdef ARDUINO
+//=====================================================================================================================================================
+// ATmega328P TWI backend: one interrupt per byte on the bus, about every 90 us at 100 kHz
+//=====================================================================================================================================================
+static void beginBus() {
+  PORTC |= _BV(PORTC4) | _BV(PORTC5);             // Internal pull-ups on SDA and SCL, like Wire
+  TWSR = 0;                                       // Prescaler 1
+  TWBR = (F_CPU / LCD_I2C_CLOCK - 16) / 2;
+  TWCR = _BV(TWEN);
+}
+
+static void startTransfer() {
+  // transferring is also cleared by the interrupt
+  uint8_t status = SREG;
+  cli();
+  if (!transferring) {
+    transferring = true;
+    // The STOP ending the previous transaction can still be on the bus for a few us
+    while (TWCR & _BV(TWSTO)) {
+    }
+    TWCR = _BV(TWINT) | _BV(TWSTA) | _BV(TWEN) | _BV(TWIE);
+  }
+  SREG = status;
+}
+
+static void waitForBus() {
+  // The interrupt makes the progress
+}
+
+ISR(TWI_vect) {
+  switch (TW_STATUS) {
+  case TW_START:
+  case TW_REP_START:
+    TWDR = busAddress << 1;                       // Write
+    TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWIE);
+    return;
+  case TW_MT_SLA_ACK:
+  case TW_MT_DATA_ACK: {
+    int16_t next = nextPortByte();
+    if (next >= 0) {
+      TWDR = next;
+      TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWIE);
+      return;
+    }
+    break;
+  }
+  default:
+    // No acknowledge or arbitration lost
+    dropQueue();
+    break;
+  }
+  TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWSTO);
+  transferring = false;
+}
+//=====================================================================================================================================================
+
+#else
+//=====================================================================================================================================================
+// Native backend: the bytes go to the simulated backpack of HalNative.cpp, one per I2C byte time when the bus timing
+// is enabled, all at once otherwise
+//=====================================================================================================================================================
+static void beginBus() {
+}
+
+static void isr_twi() {
+  int16_t next = nextPortByte();
+  if (next >= 0) {
+    sim_i2cWrite(next);
+    return;
+  }
+  sim_i2cStop();
+  sim_detachTimerInterrupt(isr_twi);
+  transferring = false;
+}
+
+static void startTransfer() {
+  if (transferring) {
+    return;
+  }
+  transferring = true;
+  if (!sim_i2cStart(busAddress)) {
+    // No acknowledge
+    dropQueue();
+    sim_i2cStop();
+    transferring = false;
+  } else if (sim_busTimingEnabled()) {
+    sim_attachTimerInterrupt(SIM_I2C_BYTE_US, isr_twi);
+  } else {
+    while (transferring) {
+      isr_twi();
+    }
+  }
+}
+
+static void waitForBus() {
+  sim_advanceMicros(SIM_I2C_BYTE_US);
+}
+//=====================================================================================================================================================
+
+#endif
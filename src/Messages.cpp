@@ -0,0 +1,43 @@
+#include <stdarg.h>
+#include "Messages.h"
+
+//=====================================================================================================================================================
+// Texts stored in flash and their address table, also in flash
+//=====================================================================================================================================================
+#define MESSAGE_TEXT(id, text) static const char text_##id[] PROGMEM = text;
+MESSAGE_TABLE(MESSAGE_TEXT)
+#undef MESSAGE_TEXT
+
+static const char* const messageTable[MESSAGE_COUNT] PROGMEM = {
+#define MESSAGE_ADDRESS(id, text) text_##id,
+  MESSAGE_TABLE(MESSAGE_ADDRESS)
+#undef MESSAGE_ADDRESS
+};
+
+static const char* messageAddress(MessageId id) {
+  return (const char*)pgm_read_ptr(&messageTable[id]);
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Output of the messages
+//=====================================================================================================================================================
+void message_print(Print& out, MessageId id) {
+  const char* text = messageAddress(id);
+  char character;
+  while ((character = pgm_read_byte(text++)) != '\0') {
+    out.write(character);
+  }
+}
+
+void message_printFormatted(Print& out, MessageId format, ...) {
+  char line[MESSAGE_MAX_LENGTH + 1];
+  va_list arguments;
+  va_start(arguments, format);
+  vsnprintf_P(line, sizeof(line), messageAddress(format), arguments);
+  va_end(arguments);
+  out.print(line);
+}
+//=====================================================================================================================================================
@@ -0,0 +1,120 @@
+#include "Power.h"
+#include "Scheduler.h"
+
+#ifdef ARDUINO
+#include <avr/io.h>
+#include <avr/power.h>
+#include <avr/sleep.h>
+#endif
+
+static unsigned long windowStart = 0;             // millis() at the start of the report window
+static unsigned long asleepMillis = 0;            // Time asleep in the window, whole ms
+static uint16_t asleepMicros = 0;                 // and the remainder below 1 ms
+static unsigned long wakeups = 0;
+static uint16_t longestSleep = 0;
+
+static void setupHardware();
+static void sleepCpu();
+
+
+
+//=====================================================================================================================================================
+// Sleep accounting
+//=====================================================================================================================================================
+static void addSleep(unsigned long duration) {
+  wakeups++;
+  if (duration > longestSleep) {
+    longestSleep = duration > 0xFFFF ? 0xFFFF : duration;
+  }
+  asleepMillis += duration / 1000;
+  asleepMicros += duration % 1000;
+  if (asleepMicros >= 1000) {
+    asleepMillis++;
+    asleepMicros -= 1000;
+  }
+}
+
+void power_begin() {
+  setupHardware();
+  windowStart = hal_millis();
+}
+
+// Interrupts are off between the check and the sleep: an interrupt that makes a task due in between still
+// ends the sleep, the instruction after SEI always runs before a pending interrupt
+void power_idle() {
+  uint8_t status = hal_disableInterrupts();
+  if (scheduler_due()) {
+    hal_restoreInterrupts(status);
+    return;
+  }
+  sleepCpu();
+}
+
+void power_takeStats(PowerStats& stats) {
+  unsigned long now = hal_millis();
+  stats.window = now - windowStart;
+  stats.asleep = asleepMillis;
+  stats.wakeups = wakeups;
+  stats.longestSleep = longestSleep;
+  windowStart = now;
+  asleepMillis = 0;
+  asleepMicros = 0;
+  wakeups = 0;
+  longestSleep = 0;
+}
+//=====================================================================================================================================================
+
+
+
+#ifdef ARDUINO
+//=====================================================================================================================================================
+// ATmega328P backend: idle mode, the timers and the peripherals of the box keep their clock
+//=====================================================================================================================================================
+static void setupHardware() {
+  ADCSRA = 0;
+  ACSR = _BV(ACD);
+  power_adc_disable();
+  set_sleep_mode(SLEEP_MODE_IDLE);
+}
+
+// Called with the interrupts off, returns with them on. The interrupt that wakes the CPU runs before micros().
+static void sleepCpu() {
+  unsigned long start = micros();
+  sleep_enable();
+  sei();
+  sleep_cpu();
+  sleep_disable();
+  addSleep(micros() - start);
+}
+//=====================================================================================================================================================
+
+#else
+//=====================================================================================================================================================
+// Native backend: the simulated CPU sleeps until the next simulated interrupt
+//=====================================================================================================================================================
+static bool sleeping = false;
+static unsigned long sleepStart = 0;              // hal_micros() when the CPU went to sleep
+
+// After the interrupt, the pass of loop() that finds no task due goes back to sleep at once
+static void wake() {
+  if (sleeping) {
+    addSleep(hal_micros() - sleepStart);
+    sleepStart = hal_micros();
+    sleeping = !scheduler_due();
+  }
+}
+
+static void setupHardware() {
+  sleeping = false;
+  sim_attachWakeHook(wake);
+}
+
+// A test may run loop() again before any interrupt, the sleep then ends there
+static void sleepCpu() {
+  wake();
+  sleeping = true;
+  sleepStart = hal_micros();
+}
+//=====================================================================================================================================================
+
+#endif
@@ -0,0 +1,155 @@
+#include "RoundTrip.h"
+#include "InputTrace.h"
+#include "Pins.h"
+
+#ifdef ARDUINO
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#endif
+
+static volatile bool armed = false;               // A command was driven and no response was seen yet
+static volatile bool completed = false;           // A measurement is waiting for roundTrip_take()
+static unsigned long driveTime;                   // micros() when the command was driven
+static volatile unsigned long responseTime;       // micros() of the first change of an input
+static uint8_t startLevel;                        // Levels of the inputs when the command was driven
+static uint8_t requestLevel;
+static volatile uint8_t responder;                // RoundTripInput that changed first
+
+
+
+//=====================================================================================================================================================
+// Measurement
+//=====================================================================================================================================================
+// Called by the change interrupts, the first input that leaves its level ends the measurement
+static void checkResponse() {
+  if (!armed) {
+    return;
+  }
+  unsigned long now = hal_micros();
+  if (StartPin::read() != startLevel) {
+    responder = ROUND_TRIP_START;
+  } else if (ShutdownRequestPin::read() != requestLevel) {
+    responder = ROUND_TRIP_SHUTDOWN_REQUEST;
+  } else {
+    return;
+  }
+  responseTime = now;
+  armed = false;
+  completed = true;
+}
+
+void roundTrip_drive(uint8_t level) {
+  uint8_t status = hal_disableInterrupts();
+  ShutdownCommandPin::write(level);
+  if (level == HIGH) {
+    driveTime = hal_micros();
+    startLevel = StartPin::read();
+    requestLevel = ShutdownRequestPin::read();
+    completed = false;
+    armed = true;
+  }
+  hal_restoreInterrupts(status);
+}
+
+bool roundTrip_take(unsigned long& latency, uint8_t& input) {
+  if (!completed) {
+    return false;
+  }
+  // The interrupt is disarmed once completed is set, the values are stable
+  latency = responseTime - driveTime;
+  input = responder;
+  completed = false;
+  return true;
+}
+
+bool roundTrip_cancel() {
+  uint8_t status = hal_disableInterrupts();
+  bool wasArmed = armed;
+  armed = false;
+  hal_restoreInterrupts(status);
+  return wasArmed;
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Statistics
+//=====================================================================================================================================================
+void roundTripStats_reset(RoundTripStats& stats) {
+  memset(&stats, 0, sizeof(stats));
+  stats.last = ROUND_TRIP_NONE;
+}
+
+void roundTripStats_add(RoundTripStats& stats, unsigned long latency) {
+  if (stats.count == 0xFFFF) {
+    return;
+  }
+  stats.count++;
+  stats.last = latency;
+  if (stats.count == 1 || latency < stats.minimum) {
+    stats.minimum = latency;
+  }
+  if (latency > stats.maximum) {
+    stats.maximum = latency;
+  }
+  // Incremental mean: no 32-bit sum to overflow after a long series
+  stats.mean = (long)stats.mean + ((long)latency - (long)stats.mean) / (long)stats.count;
+  uint8_t bin = roundTripStats_bin(latency);
+  if (stats.histogram[bin] < 0xFFFF) {
+    stats.histogram[bin]++;
+  }
+}
+
+void roundTripStats_miss(RoundTripStats& stats) {
+  if (stats.missed < 0xFFFF) {
+    stats.missed++;
+  }
+  stats.last = ROUND_TRIP_NONE;
+}
+
+uint8_t roundTripStats_bin(unsigned long latency) {
+  uint8_t bin = 0;
+  for (unsigned long limit = 1000; bin < ROUND_TRIP_BINS - 1 && latency >= limit; limit *= 2) {
+    bin++;
+  }
+  return bin;
+}
+//=====================================================================================================================================================
+
+
+
+#ifdef ARDUINO
+//=====================================================================================================================================================
+// ATmega328P backend: PCINT21 (D5) and PCINT22 (D6) share the port D pin-change interrupt, which also feeds the
+// input trace while it records
+//=====================================================================================================================================================
+void roundTrip_begin() {
+  PCMSK2 |= _BV(PCINT21) | _BV(PCINT22);
+  PCIFR = _BV(PCIF2);
+  PCICR |= _BV(PCIE2);
+}
+
+ISR(PCINT2_vect) {
+  checkResponse();
+  inputTrace_portChanged();
+}
+//=====================================================================================================================================================
+
+#else
+//=====================================================================================================================================================
+// Native backend: the simulated port D pin-change interrupt
+//=====================================================================================================================================================
+static void isr_portChange() {
+  checkResponse();
+  inputTrace_portChanged();
+}
+
+void roundTrip_begin() {
+  armed = false;
+  completed = false;
+  sim_attachPortChangeInterrupt(isr_portChange);
+}
+//=====================================================================================================================================================
+
+#endif
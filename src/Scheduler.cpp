@@ -0,0 +1,71 @@
+#include "Scheduler.h"
+
+static Task tasks[SCHEDULER_MAX_TASKS];           // Registered tasks
+static uint8_t taskCount = 0;                     // Number of registered tasks
+
+
+
+//=====================================================================================================================================================
+// Task registration
+//=====================================================================================================================================================
+bool scheduler_addTask(TaskFunction run, unsigned long interval) {
+  if (taskCount >= SCHEDULER_MAX_TASKS) {
+    return false;
+  }
+  tasks[taskCount].run = run;
+  tasks[taskCount].interval = interval;
+  tasks[taskCount].lastRun = hal_millis();
+  taskCount++;
+  return true;
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Runs the tasks that are due, in registration order
+//=====================================================================================================================================================
+void scheduler_run() {
+  for (uint8_t i = 0; i < taskCount; i++) {
+    unsigned long now = hal_millis();
+    // Unsigned subtraction keeps working when millis() overflows after ~49 days
+    if (now - tasks[i].lastRun >= tasks[i].interval) {
+      tasks[i].lastRun = now;
+      tasks[i].run();
+    }
+  }
+}
+
+bool scheduler_due() {
+  unsigned long now = hal_millis();
+  for (uint8_t i = 0; i < taskCount; i++) {
+    if (now - tasks[i].lastRun >= tasks[i].interval) {
+      return true;
+    }
+  }
+  return false;
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Non-blocking timer
+//=====================================================================================================================================================
+void timer_start(Timer& timer, unsigned long duration) {
+  timer.start = hal_millis();
+  timer.duration = duration;
+}
+
+bool timer_expired(const Timer& timer) {
+  return hal_millis() - timer.start >= timer.duration;
+}
+
+unsigned long timer_remainingSeconds(const Timer& timer) {
+  unsigned long elapsed = hal_millis() - timer.start;
+  if (elapsed >= timer.duration) {
+    return 0;
+  }
+  return (timer.duration - elapsed + 999) / 1000;
+}
+//=====================================================================================================================================================
@@ -0,0 +1,239 @@
+#include "SequenceTable.h"
+#include "EdgeCapture.h"
+#include "Messages.h"
+#include "Pins.h"
+
+//=====================================================================================================================================================
+// Screens
+//=====================================================================================================================================================
+static constexpr ScreenDescriptor screenTable[SCREEN_COUNT] PROGMEM = {
+  // SCREEN_EMERGENCY_COUNTDOWN
+  { { { 3, MSG_FIRST_TEST },
+      { 3, MSG_EMERGENCY_STOP },
+      { 4, MSG_FORMAT_WAITING },
+      { 0, MSG_NONE } } },
+  // SCREEN_EMERGENCY_OK
+  { { { 1, MSG_EMERGENCY_STOP_OK },
+      { 0, MSG_FORMAT_EDGE_STATS },
+      { 1, MSG_PUSH_NEXT_BUTTON },
+      { 1, MSG_IF_THE_TEST_IS_OK } } },
+  // SCREEN_EMERGENCY_NOK
+  { { { 1, MSG_EMERGENCY_STOP_NOK },
+      { 0, MSG_FORMAT_EDGE_STATS },
+      { 1, MSG_PUSH_NEXT_BUTTON },
+      { 1, MSG_IF_THE_TEST_IS_OK } } },
+  // SCREEN_WALL_SWITCH_COUNTDOWN
+  { { { 3, MSG_SECOND_TEST },
+      { 5, MSG_CHECK_THE },
+      { 2, MSG_POWER_SUPPLY_24V },
+      { 4, MSG_FORMAT_WAITING } } },
+  // SCREEN_WALL_SWITCH_PRESENT
+  { { { 0, MSG_WALL_SWITCH_PRESENT },
+      { 0, MSG_FORMAT_EDGE_STATS },
+      { 0, MSG_PUSH_NEXT_BUTTON_IF },
+      { 0, MSG_WALL_SWITCH_PRESENT } } },
+  // SCREEN_WALL_SWITCH_MISSING
+  { { { 0, MSG_WALL_SWITCH_MISSING },
+      { 0, MSG_FORMAT_EDGE_STATS },
+      { 0, MSG_PUSH_NEXT_BUTTON_IF },
+      { 0, MSG_WALL_SWITCH_PRESENT } } },
+  // SCREEN_START_SCANNER_COUNTDOWN
+  { { { 1, MSG_THIRD_TEST_CHECK },
+      { 2, MSG_IF_THE_SCANNER },
+      { 5, MSG_STARTS_UP },
+      { 4, MSG_FORMAT_WAITING } } },
+  // SCREEN_START_SCANNER_CHOICE
+  { { { 5, MSG_IF_FORCE },
+      { 1, MSG_PUSH_NEXT_BUTTON },
+      { 0, MSG_IF_X_CITE_CEED_GO },
+      { 0, MSG_PUSH_LITTLE_BUTTON } } },
+  // SCREEN_START_SCANNER_ENERGIZED
+  { { { 2, MSG_GANTRY_SHOULD_BE },
+      { 6, MSG_ENERGIZED },
+      { 0, MSG_PUSH_NEXT_BUTTON_IF },
+      { 0, MSG_GANTRY_IS_ENERGIZED } } },
+  // SCREEN_START_SCANNER_FORCE
+  { { { 3, MSG_TEST_FORCE },
+      { 2, MSG_PUSH_THE_GREEN },
+      { 5, MSG_BUTTON_ON },
+      { 0, MSG_ELECTRICAL_CABINET } } },
+  // SCREEN_START_SCANNER_FORCE_QUESTION
+  { { { 3, MSG_DID_THE_FORCE },
+      { 2, MSG_SYSTEM_START_UP },
+      { 0, MSG_WITHOUT_ANY_PROBLEM },
+      { 1, MSG_IF_YES_PUSH_NEXT } } },
+  // SCREEN_SHUTDOWN_REQUEST_COUNTDOWN
+  { { { 4, MSG_FOURTH_TEST },
+      { 6, MSG_CHECK_THE },
+      { 2, MSG_SHUTDOWN_REQUEST },
+      { 4, MSG_FORMAT_WAITING } } },
+  // SCREEN_SHUTDOWN_REQUEST_PUSH_RED
+  { { { 0, MSG_PUSH_THE_RED_BUTTON },
+      { 3, MSG_ON_ELECTRICAL },
+      { 6, MSG_CABINET },
+      { 0, MSG_NONE } } },
+  // SCREEN_SHUTDOWN_REQUEST_OK
+  { { { 0, MSG_TITLE_SHUTDOWN_REQUEST_OK },
+      { 0, MSG_FORMAT_CAPTURE_STATS },
+      { 0, MSG_SHUTDOWN_REQUEST_OK },
+      { 0, MSG_ARROW_PUSH_NEXT_BUTTON } } },
+  // SCREEN_SHUTDOWN_REQUEST_GLITCH
+  { { { 0, MSG_TITLE_SHUTDOWN_REQUEST_NOK },
+      { 0, MSG_FORMAT_CAPTURE_STATS },
+      { 0, MSG_CONTACT_GLITCHES },
+      { 0, MSG_ARROW_PUSH_NEXT_BUTTON } } },
+  // SCREEN_SHUTDOWN_COMMAND_COUNTDOWN
+  { { { 2, MSG_THE_SYSTEM_WILL },
+      { 3, MSG_SHUT_DOWN_IN },
+      { 9, MSG_FORMAT_SECONDS },
+      { 0, MSG_NONE } } },
+  // SCREEN_SHUTDOWN_COMMAND_QUESTION
+  { { { 2, MSG_DID_THE_SYSTEM },
+      { 1, MSG_SHUT_DOWN_WITHOUT },
+      { 4, MSG_ANY_PROBLEM },
+      { 0, MSG_IF_YES_PUSH_NEXT_BANG } } },
+  // SCREEN_SHUTDOWN_COMMAND_OK
+  { { { 0, MSG_TITLE_SHUTDOWN_COMMAND_OK },
+      { 1, MSG_IF_THE_TEST_IS },
+      { 0, MSG_SHUTDOWN_COMMAND_OK },
+      { 0, MSG_ARROW_PUSH_NEXT_BUTTON } } },
+  // SCREEN_SHUTDOWN_COMMAND_LATENCY
+  { { { 0, MSG_LATENCY_MIN_AVG_MAX },
+      { 0, MSG_FORMAT_ROUND_TRIP_STATS },
+      { 0, MSG_FORMAT_ROUND_TRIP_LAST },
+      { 0, MSG_FORMAT_ROUND_TRIP_HISTOGRAM } } },
+  // SCREEN_SHUTDOWN_COMMAND_FINAL_TEST
+  { { { 4, MSG_FINAL_TEST },
+      { 0, MSG_CHECK_THE_INDICATOR },
+      { 0, MSG_LIGHTS_FOR_X_RAY_ON },
+      { 2, MSG_AND_X_RAY_READY } } },
+  // SCREEN_SHUTDOWN_COMMAND_TURN_OFF
+  { { { 0, MSG_IF_THE_X_RAY_TESTS },
+      { 2, MSG_ARE_COMPLETED },
+      { 0, MSG_PRESS_NEXT_BUTTON },
+      { 0, MSG_TURN_OFF_THE_CASING } } },
+  // SCREEN_PASSIVE_COUNTDOWN
+  { { { 3, MSG_FIRST_TESTS },
+      { 3, MSG_EMERGENCY_STOP },
+      { 2, MSG_POWER_SUPPLY_24V },
+      { 4, MSG_FORMAT_WAITING } } },
+  // SCREEN_PASSIVE_SUMMARY
+  { { { 0, MSG_FORMAT_CHECK_SUMMARY },
+      { 0, MSG_FORMAT_CHECK_SUMMARY },
+      { 1, MSG_PUSH_NEXT_BUTTON },
+      { 1, MSG_IF_THE_TEST_IS_OK } } },
+};
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Sequence 1: Checks the signal received from the EMERGENCY STOP
+//=====================================================================================================================================================
+// Sequences 1 and 2 are passive level checks on two different inputs: they run together, with the same step layout.
+static constexpr StepDescriptor steps_EMERGENCY[] PROGMEM = {
+  // screen                              failScreen                      groupScreen               pin                       level seconds settle         flags                                                  next      onPress
+  { SCREEN_EMERGENCY_COUNTDOWN,          SCREEN_COUNT,                   SCREEN_PASSIVE_COUNTDOWN, pin_Emergency,            LOW,  10,     SETTLE_WINDOW, 0,                                                     1,        STEP_END },
+  { SCREEN_EMERGENCY_OK,                 SCREEN_EMERGENCY_NOK,           SCREEN_PASSIVE_SUMMARY,   pin_Emergency,            LOW,  0,      0,             STEP_SHOW_LEVEL | STEP_CONFIRM,                        STEP_END, STEP_END },
+};
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Séquence 2 : Checks the signal received from the 24V DC power supply
+//=====================================================================================================================================================
+static constexpr StepDescriptor steps_WALL_SWITCH_FEEDBACK[] PROGMEM = {
+  // screen                              failScreen                      groupScreen               pin                       level seconds settle         flags                                                  next      onPress
+  { SCREEN_WALL_SWITCH_COUNTDOWN,        SCREEN_COUNT,                   SCREEN_PASSIVE_COUNTDOWN, pin_Wall_switch,          LOW,  10,     SETTLE_WINDOW, 0,                                                     1,        STEP_END },
+  { SCREEN_WALL_SWITCH_PRESENT,          SCREEN_WALL_SWITCH_MISSING,     SCREEN_PASSIVE_SUMMARY,   pin_Wall_switch,          LOW,  0,      0,             STEP_SHOW_LEVEL | STEP_CONFIRM,                        STEP_END, STEP_END },
+};
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Sequence 3: Checks the signal received when the machine starts by pressing the START button
+//=====================================================================================================================================================
+// Step 1 waits for the START signal (gantry energized, step 2); Force systems are started from the electrical cabinet
+// instead, the operator then pushes the next button and follows steps 3 and 4.
+static constexpr StepDescriptor steps_START_SCANNER[] PROGMEM = {
+  // screen                              failScreen                      groupScreen               pin                       level seconds settle         flags                                                  next      onPress
+  { SCREEN_START_SCANNER_COUNTDOWN,      SCREEN_COUNT,                   SCREEN_COUNT,             NO_PIN,                   LOW,  10,     0,             0,                                                     1,        STEP_END },
+  { SCREEN_START_SCANNER_CHOICE,         SCREEN_COUNT,                   SCREEN_COUNT,             pin_Start,                LOW,  0,      0,             STEP_WAIT_LEVEL | STEP_CONFIRM,                        2,        3 },
+  { SCREEN_START_SCANNER_ENERGIZED,      SCREEN_COUNT,                   SCREEN_COUNT,             NO_PIN,                   LOW,  0,      0,             STEP_CONFIRM,                                          STEP_END, STEP_END },
+  { SCREEN_START_SCANNER_FORCE,          SCREEN_COUNT,                   SCREEN_COUNT,             NO_PIN,                   LOW,  10,     0,             0,                                                     4,        STEP_END },
+  { SCREEN_START_SCANNER_FORCE_QUESTION, SCREEN_COUNT,                   SCREEN_COUNT,             NO_PIN,                   LOW,  0,      0,             STEP_CONFIRM,                                          STEP_END, STEP_END },
+};
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Sequence 4: Checks the signal received when the machine sends a scanner shutdown request after pressing the stop button
+//=====================================================================================================================================================
+// The operator can skip the test with the next button while the request is awaited.
+static constexpr StepDescriptor steps_SHUTDOWN_REQUEST[] PROGMEM = {
+  // screen                              failScreen                      groupScreen               pin                       level seconds settle         flags                                                  next      onPress
+  { SCREEN_SHUTDOWN_REQUEST_COUNTDOWN,   SCREEN_COUNT,                   SCREEN_COUNT,             pin_Shutdown_request,     LOW,  10,     SETTLE_WINDOW, 0,                                                     1,        STEP_END },
+  { SCREEN_SHUTDOWN_REQUEST_PUSH_RED,    SCREEN_COUNT,                   SCREEN_COUNT,             pin_Shutdown_request,     HIGH, 0,      0,             STEP_WAIT_LEVEL | STEP_CAPTURE | STEP_CONFIRM,         2,        STEP_END },
+  { SCREEN_SHUTDOWN_REQUEST_OK,          SCREEN_SHUTDOWN_REQUEST_GLITCH, SCREEN_COUNT,             NO_PIN,                   LOW,  0,      0,             STEP_CONFIRM,                                          STEP_END, STEP_END },
+};
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Sequence 5: Controls the output to the relay
+//=====================================================================================================================================================
+static constexpr StepDescriptor steps_SHUTDOWN_COMMAND[] PROGMEM = {
+  // screen                              failScreen                      groupScreen               pin                       level seconds settle         flags                                                  next      onPress
+  { SCREEN_SHUTDOWN_COMMAND_COUNTDOWN,   SCREEN_COUNT,                   SCREEN_COUNT,             pin_Shutdown_request,     LOW,  20,     SETTLE_WINDOW, 0,                                                     1,        STEP_END },
+  { SCREEN_SHUTDOWN_COMMAND_QUESTION,    SCREEN_COUNT,                   SCREEN_COUNT,             out_pin_Shutdown_command, HIGH, 0,      0,             STEP_DRIVE_OUTPUT | STEP_TIME_RESPONSE | STEP_CONFIRM, STEP_END, 2 },
+  { SCREEN_SHUTDOWN_COMMAND_OK,          SCREEN_COUNT,                   SCREEN_COUNT,             out_pin_Shutdown_command, LOW,  0,      0,             STEP_DRIVE_OUTPUT | STEP_CONFIRM,                      STEP_END, 3 },
+  { SCREEN_SHUTDOWN_COMMAND_LATENCY,     SCREEN_COUNT,                   SCREEN_COUNT,             NO_PIN,                   LOW,  0,      0,             STEP_CONFIRM,                                          STEP_END, 4 },
+  { SCREEN_SHUTDOWN_COMMAND_FINAL_TEST,  SCREEN_COUNT,                   SCREEN_COUNT,             NO_PIN,                   LOW,  5,      0,             0,                                                     5,        STEP_END },
+  { SCREEN_SHUTDOWN_COMMAND_TURN_OFF,    SCREEN_COUNT,                   SCREEN_COUNT,             NO_PIN,                   LOW,  0,      0,             STEP_CONFIRM,                                          STEP_END, STEP_END },
+};
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Sequence table, in the order of SequenceState
+//=====================================================================================================================================================
+#define STEPS(table) table, sizeof(table) / sizeof(table[0])
+
+static constexpr SequenceDescriptor sequenceTable[SEQUENCE_COUNT] PROGMEM = {
+  { STEPS(steps_EMERGENCY),            EDGE_EMERGENCY,     MSG_E_STOP },
+  { STEPS(steps_WALL_SWITCH_FEEDBACK), EDGE_WALL_SWITCH,   MSG_WALL_SWITCH },
+  { STEPS(steps_START_SCANNER),        EDGE_CHANNEL_COUNT, MSG_NONE },
+  { STEPS(steps_SHUTDOWN_REQUEST),     EDGE_CHANNEL_COUNT, MSG_NONE },
+  { STEPS(steps_SHUTDOWN_COMMAND),     EDGE_CHANNEL_COUNT, MSG_NONE },
+};
+
+#undef STEPS
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Access to the tables in flash
+//=====================================================================================================================================================
+void sequenceTable_readStep(uint8_t sequence, uint8_t step, StepDescriptor& out) {
+  const StepDescriptor* steps = (const StepDescriptor*)pgm_read_ptr(&sequenceTable[sequence].steps);
+  memcpy_P(&out, &steps[step], sizeof(StepDescriptor));
+}
+
+void sequenceTable_readScreen(uint8_t screen, ScreenDescriptor& out) {
+  memcpy_P(&out, &screenTable[screen], sizeof(ScreenDescriptor));
+}
+
+uint8_t sequenceTable_edgeChannel(uint8_t sequence) {
+  return pgm_read_byte(&sequenceTable[sequence].edgeChannel);
+}
+
+uint8_t sequenceTable_summary(uint8_t sequence) {
+  return pgm_read_byte(&sequenceTable[sequence].summary);
+}
+//=====================================================================================================================================================
@@ -0,0 +1,227 @@
+#include "Telemetry.h"
+#include "Uart.h"
+
+static uint16_t droppedFrames = 0;
+
+
+
+//=====================================================================================================================================================
+// Frame construction
+//=====================================================================================================================================================
+// Small writer used to fill a payload without any heap or String
+struct FrameWriter {
+  uint8_t frame[TELEMETRY_MAX_PAYLOAD + TELEMETRY_FRAME_OVERHEAD];
+  uint8_t length;
+
+  explicit FrameWriter(uint8_t type) : length(3) {
+    frame[0] = TELEMETRY_SYNC;
+    frame[1] = type;
+  }
+
+  void put8(uint8_t value) {
+    frame[length++] = value;
+  }
+
+  void put16(uint16_t value) {
+    frame[length++] = value & 0xFF;
+    frame[length++] = value >> 8;
+  }
+
+  void put32(unsigned long value) {
+    for (uint8_t i = 0; i < 4; i++) {
+      frame[length++] = (value >> (8 * i)) & 0xFF;
+    }
+  }
+
+  void send() {
+    frame[2] = length - 3;
+    uint16_t crc = telemetry_crc16(0xFFFF, &frame[1], length - 1);
+    frame[length++] = crc & 0xFF;
+    frame[length++] = crc >> 8;
+    if (!uart_write(frame, length) && droppedFrames < 0xFFFF) {
+      droppedFrames++;
+    }
+  }
+};
+
+uint16_t telemetry_crc16(uint16_t crc, const uint8_t* data, uint8_t length) {
+  for (uint8_t i = 0; i < length; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Frames
+//=====================================================================================================================================================
+void telemetry_begin() {
+  uart_begin(UART_BAUD_RATE);
+}
+
+void telemetry_sequenceStart(uint8_t sequence) {
+  FrameWriter writer(FRAME_SEQUENCE_START);
+  writer.put8(sequence);
+  writer.put32(hal_millis());
+  writer.send();
+}
+
+void telemetry_sequenceEnd(uint8_t sequence, uint8_t verdict, unsigned long duration, unsigned long settleTime) {
+  FrameWriter writer(FRAME_SEQUENCE_END);
+  writer.put8(sequence);
+  writer.put8(verdict);
+  writer.put32(hal_millis());
+  writer.put32(duration);
+  writer.put32(settleTime);
+  writer.send();
+}
+
+void telemetry_edge(const EdgeEvent& edge) {
+  FrameWriter writer(FRAME_EDGE);
+  writer.put8(edge.channel);
+  writer.put8(edge.level);
+  writer.put32(edge.timestamp);
+  writer.send();
+}
+
+void telemetry_edgeStats(uint8_t sequence, uint8_t channel, const EdgeStats& stats) {
+  FrameWriter writer(FRAME_EDGE_STATS);
+  writer.put8(sequence);
+  writer.put8(channel);
+  writer.put8(stats.edges);
+  writer.put8(stats.bounces);
+  writer.put32(edgeStats_responseTime(stats));
+  writer.put32(edgeStats_settleTime(stats));
+  writer.send();
+}
+
+void telemetry_roundTrip(uint8_t input, unsigned long latency) {
+  FrameWriter writer(FRAME_ROUND_TRIP);
+  writer.put8(input);
+  writer.put32(latency);
+  writer.send();
+}
+
+void telemetry_roundTripStats(const RoundTripStats& stats) {
+  FrameWriter summary(FRAME_ROUND_TRIP_STATS);
+  summary.put16(stats.count);
+  summary.put16(stats.missed);
+  summary.put32(stats.minimum);
+  summary.put32(stats.mean);
+  summary.put32(stats.maximum);
+  summary.send();
+
+  FrameWriter histogram(FRAME_ROUND_TRIP_HISTOGRAM);
+  for (uint8_t bin = 0; bin < ROUND_TRIP_BINS; bin++) {
+    histogram.put16(stats.histogram[bin]);
+  }
+  histogram.send();
+}
+
+static void sendRecord(uint8_t type, const JournalRecord& record) {
+  FrameWriter writer(type);
+  writer.put16(record.run);
+  writer.put16(record.verdicts);
+  writer.put16(record.emergencyResponse);
+  writer.put16(record.emergencySettle);
+  writer.put16(record.wallSwitchResponse);
+  writer.put16(record.wallSwitchSettle);
+  writer.put16(record.roundTrip);
+  writer.put8(record.bounces);
+  writer.put8(record.checksum);
+  writer.send();
+}
+
+void telemetry_journalRecord(const JournalRecord& record) {
+  sendRecord(FRAME_JOURNAL_RECORD, record);
+}
+
+void telemetry_journalEnd(uint8_t records) {
+  FrameWriter writer(FRAME_JOURNAL_END);
+  writer.put8(records);
+  writer.send();
+}
+
+void telemetry_captureStats(const WaveStats& stats) {
+  FrameWriter writer(FRAME_CAPTURE_STATS);
+  writer.put8(stats.edges);
+  writer.put8(stats.glitches);
+  writer.put32(stats.minWidth);
+  writer.put32(stats.maxWidth);
+  writer.put16(CAPTURE_SAMPLE_PERIOD_US);
+  writer.put16(CAPTURE_SAMPLES);
+  writer.put16(waveCapture_triggerSample());
+  writer.send();
+}
+
+void telemetry_captureTrace(uint8_t offset, uint8_t length) {
+  FrameWriter writer(FRAME_CAPTURE_TRACE);
+  writer.put8(offset);
+  for (uint8_t i = 0; i < length; i++) {
+    writer.put8(waveCapture_traceByte(offset + i));
+  }
+  writer.send();
+}
+
+void telemetry_status(uint8_t sequence, uint8_t step, uint8_t screen, uint8_t levels, uint8_t output, uint16_t countdown) {
+  FrameWriter writer(FRAME_STATUS);
+  writer.put8(sequence);
+  writer.put8(step);
+  writer.put8(screen);
+  writer.put8(levels);
+  writer.put8(output);
+  writer.put16(countdown);
+  writer.send();
+}
+
+void telemetry_cycleRecord(const JournalRecord& record) {
+  sendRecord(FRAME_CYCLE_RECORD, record);
+}
+
+void telemetry_commandAck(uint8_t command, bool accepted, uint8_t sequence) {
+  FrameWriter writer(FRAME_COMMAND_ACK);
+  writer.put8(command);
+  writer.put8(accepted ? 1 : 0);
+  writer.put8(sequence);
+  writer.send();
+}
+
+void telemetry_inputTraceStart(unsigned long time, uint8_t levels) {
+  FrameWriter writer(FRAME_INPUT_TRACE_START);
+  writer.put32(time);
+  writer.put8(levels);
+  writer.send();
+}
+
+void telemetry_inputTransition(const InputTransition& transition) {
+  FrameWriter writer(FRAME_INPUT_TRANSITION);
+  writer.put32(transition.time);
+  writer.put8(transition.levels);
+  writer.send();
+}
+
+void telemetry_inputTraceEnd(uint16_t transitions, uint8_t overflows) {
+  FrameWriter writer(FRAME_INPUT_TRACE_END);
+  writer.put16(transitions);
+  writer.put8(overflows);
+  writer.send();
+}
+
+void telemetry_powerStats(const PowerStats& stats) {
+  FrameWriter writer(FRAME_POWER_STATS);
+  writer.put32(stats.window);
+  writer.put32(stats.asleep);
+  writer.put32(stats.wakeups);
+  writer.put16(stats.longestSleep);
+  writer.send();
+}
+
+uint16_t telemetry_droppedFrames() {
+  return droppedFrames;
+}
+//=====================================================================================================================================================
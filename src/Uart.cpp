@@ -0,0 +1,127 @@
+#include "Uart.h"
+
+#ifdef ARDUINO
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#endif
+
+static uint8_t txBuffer[UART_TX_BUFFER_SIZE];     // Bytes waiting to be sent
+static volatile uint8_t txHead = 0;               // Next slot written by uart_write()
+static volatile uint8_t txTail = 0;               // Next byte sent by the interrupt
+static uint8_t rxBuffer[UART_RX_BUFFER_SIZE];     // Bytes received and not read yet
+static volatile uint8_t rxHead = 0;               // Next slot written by the interrupt
+static volatile uint8_t rxTail = 0;               // Next byte returned by uart_read()
+
+
+
+//=====================================================================================================================================================
+// Ring buffer side shared by both backends
+//=====================================================================================================================================================
+uint8_t uart_txFree() {
+  return (txTail - txHead - 1) & (UART_TX_BUFFER_SIZE - 1);
+}
+
+static void startTransmission();
+
+bool uart_write(const uint8_t* data, uint8_t length) {
+  if (length > uart_txFree()) {
+    return false;
+  }
+  uint8_t head = txHead;
+  for (uint8_t i = 0; i < length; i++) {
+    txBuffer[head] = data[i];
+    head = (head + 1) & (UART_TX_BUFFER_SIZE - 1);
+  }
+  // Publish the bytes only once they are all in the ring
+  txHead = head;
+  startTransmission();
+  return true;
+}
+
+int uart_read() {
+  uint8_t tail = rxTail;
+  if (tail == rxHead) {
+    return -1;
+  }
+  uint8_t data = rxBuffer[tail];
+  rxTail = (tail + 1) & (UART_RX_BUFFER_SIZE - 1);
+  return data;
+}
+
+// Called by the receive interrupt, bytes are dropped when the ring is full
+static void receiveByte(uint8_t data) {
+  uint8_t next = (rxHead + 1) & (UART_RX_BUFFER_SIZE - 1);
+  if (next != rxTail) {
+    rxBuffer[rxHead] = data;
+    rxHead = next;
+  }
+}
+//=====================================================================================================================================================
+
+
+
+#ifdef ARDUINO
+//=====================================================================================================================================================
+// ATmega328P USART0 backend
+//=====================================================================================================================================================
+void uart_begin(unsigned long baudRate) {
+  // Double speed mode gives the smallest baud rate error at 115200 with a 16 MHz crystal
+  uint16_t divider = (F_CPU / 4 / baudRate - 1) / 2;
+  UCSR0A = _BV(U2X0);
+  UBRR0H = divider >> 8;
+  UBRR0L = divider & 0xFF;
+  UCSR0C = _BV(UCSZ01) | _BV(UCSZ00);             // 8 data bits, no parity, 1 stop bit
+  UCSR0B = _BV(RXEN0) | _BV(TXEN0) | _BV(RXCIE0);
+}
+
+static void startTransmission() {
+  // UCSR0B is also modified by the interrupt
+  uint8_t status = SREG;
+  cli();
+  UCSR0B |= _BV(UDRIE0);
+  SREG = status;
+}
+
+ISR(USART_UDRE_vect) {
+  uint8_t tail = txTail;
+  if (tail == txHead) {
+    // Nothing left to send: stop the interrupt until the next uart_write()
+    UCSR0B &= ~_BV(UDRIE0);
+    return;
+  }
+  UDR0 = txBuffer[tail];
+  txTail = (tail + 1) & (UART_TX_BUFFER_SIZE - 1);
+}
+
+ISR(USART_RX_vect) {
+  receiveByte(UDR0);
+}
+//=====================================================================================================================================================
+
+#else
+//=====================================================================================================================================================
+// Native backend: the test plays the role of the interrupts
+//=====================================================================================================================================================
+void uart_begin(unsigned long) {
+}
+
+static void startTransmission() {
+}
+
+size_t sim_uartTake(uint8_t* buffer, size_t size) {
+  size_t count = 0;
+  while (count < size && txTail != txHead) {
+    buffer[count++] = txBuffer[txTail];
+    txTail = (txTail + 1) & (UART_TX_BUFFER_SIZE - 1);
+  }
+  return count;
+}
+
+void sim_uartReceive(const uint8_t* data, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    receiveByte(data[i]);
+  }
+}
+//=====================================================================================================================================================
+
+#endif
@@ -0,0 +1,185 @@
+#include "WaveCapture.h"
+#include "Pins.h"
+
+#ifdef ARDUINO
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#endif
+
+static uint8_t trace[CAPTURE_BUFFER_SIZE];        // Bit-packed ring of samples
+static volatile uint16_t writeIndex = 0;          // Next sample written by the interrupt
+static volatile uint16_t remaining = 0;           // Samples left to take after the trigger, 0 before it
+static volatile bool armed = false;
+static volatile bool triggered = false;
+static volatile bool done = false;
+static uint8_t triggerLevel;
+static uint8_t lastSample;
+
+static void startTimer();
+static void stopTimer();
+
+
+
+//=====================================================================================================================================================
+// Sampling, called by the timer interrupt
+//=====================================================================================================================================================
+static void sample() {
+  uint8_t level = ShutdownRequestPin::read();
+  uint16_t index = writeIndex;
+  uint8_t mask = 1 << (index & 7);
+  if (level == HIGH) {
+    trace[index >> 3] |= mask;
+  } else {
+    trace[index >> 3] &= ~mask;
+  }
+  writeIndex = (index + 1) & (CAPTURE_SAMPLES - 1);
+
+  if (!triggered) {
+    if (level == triggerLevel && lastSample != triggerLevel) {
+      triggered = true;
+      // The trigger sample ends up CAPTURE_PRE_TRIGGER samples after the oldest one
+      remaining = CAPTURE_SAMPLES - CAPTURE_PRE_TRIGGER - 1;
+    }
+    lastSample = level;
+  } else if (--remaining == 0) {
+    armed = false;
+    done = true;
+    stopTimer();
+  }
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Control and trace access
+//=====================================================================================================================================================
+void waveCapture_arm(uint8_t level) {
+  stopTimer();
+  // The ring starts at the level the line is idle at, so a trigger shortly after arming sees no false edge
+  lastSample = ShutdownRequestPin::read();
+  memset(trace, lastSample == HIGH ? 0xFF : 0x00, sizeof(trace));
+  triggerLevel = level;
+  writeIndex = 0;
+  remaining = 0;
+  triggered = false;
+  done = false;
+  armed = true;
+  startTimer();
+}
+
+void waveCapture_stop() {
+  stopTimer();
+  armed = false;
+}
+
+bool waveCapture_armed() {
+  return armed;
+}
+
+bool waveCapture_done() {
+  return done;
+}
+
+// Once done, writeIndex points to the oldest sample
+uint8_t waveCapture_traceByte(uint8_t index) {
+  uint16_t first = writeIndex + index * 8;
+  uint8_t value = 0;
+  for (uint8_t bit = 0; bit < 8; bit++) {
+    uint16_t position = (first + bit) & (CAPTURE_SAMPLES - 1);
+    if (trace[position >> 3] & (1 << (position & 7))) {
+      value |= 1 << bit;
+    }
+  }
+  return value;
+}
+
+uint16_t waveCapture_triggerSample() {
+  return CAPTURE_PRE_TRIGGER;
+}
+
+static uint8_t sampleAt(uint16_t sample) {
+  uint16_t position = (writeIndex + sample) & (CAPTURE_SAMPLES - 1);
+  return (trace[position >> 3] >> (position & 7)) & 1;
+}
+
+// The levels before the first edge and after the last one are cut by the window, only the complete ones are measured
+void waveCapture_analyse(WaveStats& stats) {
+  stats.edges = 0;
+  stats.bounces = 0;
+  stats.glitches = 0;
+  stats.minWidth = 0;
+  stats.maxWidth = 0;
+
+  const uint16_t bounceEnd = CAPTURE_PRE_TRIGGER + CAPTURE_BOUNCE_US / CAPTURE_SAMPLE_PERIOD_US;
+  int16_t lastEdge = -1;
+  uint8_t level = sampleAt(0);
+  for (uint16_t sample = 1; sample < CAPTURE_SAMPLES; sample++) {
+    uint8_t next = sampleAt(sample);
+    if (next == level) {
+      continue;
+    }
+    level = next;
+    if (stats.edges < 255) {
+      stats.edges++;
+    }
+    if (sample > CAPTURE_PRE_TRIGGER && sample <= bounceEnd && stats.bounces < 255) {
+      stats.bounces++;
+    }
+    if (lastEdge >= 0) {
+      unsigned long width = (unsigned long)(sample - lastEdge) * CAPTURE_SAMPLE_PERIOD_US;
+      if (stats.minWidth == 0 || width < stats.minWidth) {
+        stats.minWidth = width;
+      }
+      if (width > stats.maxWidth) {
+        stats.maxWidth = width;
+      }
+      if (width < CAPTURE_GLITCH_US && lastEdge > (int16_t)bounceEnd && stats.glitches < 255) {
+        stats.glitches++;
+      }
+    }
+    lastEdge = sample;
+  }
+}
+//=====================================================================================================================================================
+
+
+
+#ifdef ARDUINO
+//=====================================================================================================================================================
+// ATmega328P Timer1 backend
+//=====================================================================================================================================================
+static void startTimer() {
+  // CTC mode, 16 MHz / 8 / 200 = 10 kHz
+  TCCR1A = 0;
+  TCCR1B = _BV(WGM12) | _BV(CS11);
+  OCR1A = F_CPU / 8 / (1000000UL / CAPTURE_SAMPLE_PERIOD_US) - 1;
+  TCNT1 = 0;
+  TIFR1 = _BV(OCF1A);
+  TIMSK1 = _BV(OCIE1A);
+}
+
+static void stopTimer() {
+  TIMSK1 = 0;
+  TCCR1B = 0;
+}
+
+ISR(TIMER1_COMPA_vect) {
+  sample();
+}
+//=====================================================================================================================================================
+
+#else
+//=====================================================================================================================================================
+// Native backend
+//=====================================================================================================================================================
+static void startTimer() {
+  sim_attachTimerInterrupt(CAPTURE_SAMPLE_PERIOD_US, sample);
+}
+
+static void stopTimer() {
+  sim_detachTimerInterrupt(sample);
+}
+//=====================================================================================================================================================
+
+#endif
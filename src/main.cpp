@@ -1,24 +1,35 @@
 //=====================================================================================================================================================
 // Necessary library inclusions
 //=====================================================================================================================================================
-#include <Adafruit_LiquidCrystal.h>
-#include <LiquidCrystal_I2C.h>
-#include <Arduino.h>
+#include "Hal.h"
+#include "Scheduler.h"
+#include "Channel.h"
+#include "Debouncer.h"
+#include "EdgeCapture.h"
+#include "IoExpander.h"
+#include "LcdI2c.h"
+#include "LcdFrameBuffer.h"
+#include "Messages.h"
+#include "Pins.h"
+#include "Power.h"
+#include "RoundTrip.h"
+#include "InputTrace.h"
+#include "Journal.h"
+#include "WaveCapture.h"
+#include "Uart.h"
+#include "SequenceTable.h"
+#include "Telemetry.h"
 //=====================================================================================================================================================
 
 
 
 //=====================================================================================================================================================
-// Pins definition
+// Timing definition (the pins are defined in Pins.h)
 //=====================================================================================================================================================
-const int pin_Emergency = 2;                      // Emergency stop signal input pin
-const int pin_Wall_switch = 3;                    // Input pin for checking the 24V DC signal on the power supply
-const int pin_Start = 5;                          // Input pin to check if the system is powered by pushing the start button of the machine
-const int pin_Shutdown_request = 6;               // Input pin for checking the scanner shutdown request
-const int out_pin_Shutdown_command = 8;           // Output pin to send a signal and turn off the scanner
-const int button_next_sequence = 7;               // Pin where the push button is connected to move to the next sequence or the next step
-const unsigned long SIGNAL_CHECK_INTERVAL = 100;  // Signal check interval every 100 ms
-unsigned long lastSignalCheckTime = 0;            // Variable to track the time elapsed since the last check
+const unsigned long SIGNAL_CHECK_INTERVAL = 100;  // Signal check interval every 100 ms (display refresh period)
+const unsigned long INPUT_SAMPLE_INTERVAL = 5;    // Debounced levels and captured edges are collected every 5 ms
+const unsigned long SEQUENCE_STEP_INTERVAL = 10;  // The current sequence advances by one step every 10 ms
+const unsigned long SERIAL_SERVICE_INTERVAL = 5;  // Serial commands are read and the journal dump refilled every 5 ms
 //=====================================================================================================================================================
 
 
@@ -26,410 +37,430 @@ unsigned long lastSignalCheckTime = 0;            // Variable to track the time
 //=====================================================================================================================================================
 // LCD screen initialization
 //=====================================================================================================================================================
-LiquidCrystal_I2C lcd(0x27,20,4);    // Adresse LCD : 0x27 ou 0x20
+LcdFrameBuffer display;              // The screens draw here, only the changed characters are sent to the LCD
 //=====================================================================================================================================================
 
 
 
 //=====================================================================================================================================================
-// Declaration of sequence functions
+// Declaration of the sequence interpreter functions
 //=====================================================================================================================================================
-void sequence_EMERGENCY();
-void sequence_WALL_SWITCH_FEEDBACK();
-void sequence_START_SCANNER();
-void sequence_SHUTDOWN_REQUEST();
-void sequence_SHUTDOWN_COMMAND();
+void enterSequence(Channel& channel, uint8_t next);
+void enterStep(Channel& channel, uint8_t index);
+void startStep(Channel& channel, uint8_t index);
+void leaveStep(Channel& channel);
+void finishSequence(Channel& channel);
+void skipSequence(Channel& channel, uint8_t next);
+void runChannel(Channel& channel);
+uint8_t groupSize(uint8_t first);
+bool consumeButtonPress(Channel& channel);
+void showScreen(Channel& channel, uint8_t screen);
+void startCountdown(Channel& channel, unsigned long seconds);
+bool countdownFinished(Channel& channel);
+void drawScreen(const Channel& channel, uint8_t screen);
 //=====================================================================================================================================================
 
 
+
 //=====================================================================================================================================================
-// State variable to track which sequence we are in
+// Declaration of scheduler tasks
 //=====================================================================================================================================================
-enum SequenceState {
-  SEQUENCE_1,
-  SEQUENCE_2,
-  SEQUENCE_3,
-  SEQUENCE_4,
-  SEQUENCE_5
-};
+void task_sampleInputs();
+void task_runSequence();
+void task_refreshDisplay();
+void task_serviceSerial();
 //=====================================================================================================================================================
 
-SequenceState currentSequence = SEQUENCE_1;  // Initialization to the first sequence
 
 //=====================================================================================================================================================
-// Initialization of variables needed for the code to continue
+// State variables to track which sequence and which step each machine is in (the sequences are described in
+// SequenceTable.cpp, the channels in Channel.h)
 //=====================================================================================================================================================
-void setup() {
-  // Configure pins as input or output
-  pinMode(pin_Emergency, INPUT_PULLUP);
-  pinMode(pin_Wall_switch, INPUT_PULLUP);
-  pinMode(pin_Start, INPUT_PULLUP);
-  pinMode(pin_Shutdown_request, INPUT_PULLUP);
-  pinMode(out_pin_Shutdown_command, OUTPUT);
-  pinMode(button_next_sequence, INPUT_PULLUP);
-  
-  //  LCD initialization
-  lcd.begin (20,4);          // for a 16x4 LCD module
-  lcd.home ();               // set the cursor to 0,0
-  lcd.setBacklight(HIGH);    // turn on backlight to the maximum
-  lcd.clear();               // clear the LCD display
-}
+Channel channels[CHANNEL_COUNT];             // Every channel runs its own sequences, task_runSequence() steps them in turn
+
+void recordResults(Channel& channel, const SequenceLane& lane);
+void analyseCapture();
+void showCaptureResult(Channel& channel);
+bool inputSettled(const Channel& channel, SequenceLane& lane);
+bool lanesSettled(Channel& channel);
+void recordSettleTimes(Channel& channel);
 //=====================================================================================================================================================
 
 
 
 //=====================================================================================================================================================
-// Main function that runs in a loop
+// Timed checks of channel 0, written by task_sampleInputs() and read by the sequences
 //=====================================================================================================================================================
-void loop() {
-  // Check if the push button is pressed to move to the next sequence or the next step
-  if (digitalRead(button_next_sequence) == LOW) {
-    delay(1000);// Debounce
-    while (digitalRead(button_next_sequence) == LOW) {
-    }
-    // Move to the next sequence
-    currentSequence = static_cast<SequenceState>((currentSequence + 1) % (SEQUENCE_5 + 1));
-  }
+EdgeStats edgeStats[EDGE_CHANNEL_COUNT];      // Edge timing of each captured input since the start of its sequence
+RoundTripStats roundTripStats;                // Shutdown command latency over every run of sequence 5 since power-up
+WaveStats captureStats;                       // Analysis of the last shutdown request trace
+bool captureAnalysed = false;                 // captureStats describes the trace of the current capture
+uint8_t captureSequence = SEQUENCE_COUNT;     // Sequence whose step armed the capture, until the sequence ends
 //=====================================================================================================================================================
 
 
 
 //=====================================================================================================================================================
-// Execute the current sequence
+// Display state, the sequences of each channel select a screen and task_refreshDisplay() draws the focused one
 //=====================================================================================================================================================
-  switch (currentSequence) {
-    case SEQUENCE_1:
-      sequence_EMERGENCY();
-      break;
-    case SEQUENCE_2:
-      sequence_WALL_SWITCH_FEEDBACK();
-      break;
-    case SEQUENCE_3:
-      sequence_START_SCANNER();
-      break;
-    case SEQUENCE_4:
-      sequence_SHUTDOWN_REQUEST();
-      break;
-    case SEQUENCE_5:
-      sequence_SHUTDOWN_COMMAND();
-      break;
-  }
-}
+// The LCD and button_next_sequence serve one machine at a time: the focus moves on to the next machine waiting for a
+// confirmation when the focused one does not need the operator.
+uint8_t focusChannel = 0;                     // Channel shown on the LCD and confirmed by the button
 //=====================================================================================================================================================
 
 
 
 //=====================================================================================================================================================
-// Sequence 1: Checks the signal received from the EMERGENCY STOP
+// Result journal: record of the running cycle, and progress of a dump requested over the serial line
 //=====================================================================================================================================================
-void sequence_EMERGENCY() {
-  static bool countdownDone = false; // Variable to track if the countdown is done
+const uint8_t COMMAND_DUMP_JOURNAL = 'D';     // Serial command: send every journal record
+const uint8_t COMMAND_SEND_TRACE = 'T';       // Serial command: send the last shutdown request trace
+const uint8_t TRACE_BYTES_PER_FRAME = TELEMETRY_MAX_PAYLOAD - 1;
 
-  // Check if the time elapsed since the last check exceeds the defined interval
-  if (millis() - lastSignalCheckTime >= SIGNAL_CHECK_INTERVAL) {
-    lastSignalCheckTime = millis(); // Update the time of the last check
+JournalRecord journalQueue[CHANNEL_COUNT];    // Cycle records waiting for the EEPROM, which writes one at a time
+uint8_t journalQueued = 0;
+bool journalDumping = false;                  // A dump is in progress
+uint8_t journalDumpSlot = 0;                  // Next slot to send, from the oldest
+uint8_t journalDumpCount = 0;                 // Records sent so far
+bool traceSending = false;                    // The last capture trace is being sent
+uint8_t traceOffset = 0;                      // Next trace byte to send
 
-    lcd.clear();
-    // If the countdown has not been done yet
-    if (!countdownDone) {
-      // Display the initial message on the LCD screen
-      lcd.setCursor(3, 0);
-      lcd.print(" First test : ");
-      lcd.setCursor(3, 1);
-      lcd.print("EMERGENCY STOP");
+void queueRecord(const JournalRecord& record);
+void appendQueuedRecord();
+//=====================================================================================================================================================
 
-      // 10-second countdown
-      for (int i = 10; i > 0; i--) {
-        lcd.setCursor(4, 2);
-        lcd.print("Waiting :" + String(i) + "s ");
-        delay(1000);
-      }
 
-      // Mark that the countdown is done
-      countdownDone = true;
-    }
-    // Check the input signal state after the countdown
-    if (digitalRead(pin_Emergency) == LOW) {
-      lcd.clear();
-      lcd.setCursor(1, 0);
-      lcd.print("EMERGENCY STOP OK");
-      lcd.setCursor(1, 2);
-      lcd.print("Push next button");
-      lcd.setCursor(1, 3);
-      lcd.print("if the test is OK");
-    } else {
-      lcd.clear();
-      lcd.setCursor(1, 0);
-      lcd.print("EMERGENCY STOP NOK");
-      lcd.setCursor(1, 2);
-      lcd.print("Push next button");
-      lcd.setCursor(1, 3);
-      lcd.print("if the test is OK");
-      
-    }
+
+//=====================================================================================================================================================
+// Remote control over the serial line, for the automated runs driven by the line PC. Each command is one byte, answered
+// by a telemetry frame: the test logic goes on as if the operator had acted.
+//=====================================================================================================================================================
+const uint8_t COMMAND_CONFIRM = 'N';          // Same as a press on button_next_sequence, accepted by the steps taking one
+const uint8_t COMMAND_SKIP = 'K';             // Ends the current sequences unchecked and moves to the next ones
+const uint8_t COMMAND_START = 'S';            // Followed by '1'..'5': ends the current sequences unchecked, starts that one
+const uint8_t COMMAND_STATUS = 'P';           // Sends the sequence position and the input and output levels
+const uint8_t COMMAND_RESULTS = 'R';          // Sends the record of the running cycle
+const uint8_t COMMAND_RECORD_INPUTS = 'I';    // Restarts the cycle at sequence 1 and records the input transitions
+const uint8_t COMMAND_STOP_RECORDING = 'O';   // Stops the recording once its transitions are sent
+const uint8_t COMMAND_CHANNEL = 'C';          // Followed by '1'..'4': the machine the next N, K, S, P and R act on
+const uint8_t COMMAND_POWER = 'W';            // Sends the time spent asleep since the previous W
+
+// Inputs reported by COMMAND_STATUS, bit n of the levels for pin Dn
+const uint8_t STATUS_PINS[] = { pin_Emergency, pin_Wall_switch, pin_Start, pin_Shutdown_request, button_next_sequence };
+
+uint8_t pendingCommand = 0;                   // Command waiting for its argument byte, 0 if none
+uint8_t remoteChannel = 0;                    // Channel selected by COMMAND_CHANNEL
+bool inputTraceEnding = false;                // The recording is stopped, its end frame follows the last transition
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Initialization of variables needed for the code to continue
+//=====================================================================================================================================================
+void setup() {
+  // Telemetry first, so that the first sequence start is reported
+  telemetry_begin();
+
+  // Configure pins as input or output
+  EmergencyPin::setMode(INPUT_PULLUP);
+  WallSwitchPin::setMode(INPUT_PULLUP);
+  StartPin::setMode(INPUT_PULLUP);
+  ShutdownRequestPin::setMode(INPUT_PULLUP);
+  ShutdownCommandPin::setMode(OUTPUT);
+  NextButtonPin::setMode(INPUT_PULLUP);
+
+  // Port D is sampled and debounced by the Timer2 interrupt from now on
+  debouncer_begin();
+
+  // The lines of the other machines are on the shift-register expander, left unused by a single machine
+  if (CHANNEL_COUNT > 1) {
+    expander_begin();
+  }
+  for (uint8_t index = 0; index < CHANNEL_COUNT; index++) {
+    channel_begin(channels[index], index);
   }
+
+  //  LCD initialization
+  lcd_begin(LCD_I2C_ADDRESS); // 4-bit mode through the PCF8574, cleared
+  lcd_setBacklight(true);    // turn on backlight to the maximum
+  display.begin();           // the shadow copy starts blank, like the LCD
+
+  // Edges on the E-stop and wall-switch inputs are timestamped by INT0 / INT1
+  edgeCapture_begin();
+
+  // pin_Start and pin_Shutdown_request changes are timestamped by the port D pin-change interrupt
+  roundTrip_begin();
+  roundTripStats_reset(roundTripStats);
+
+  // Results of the previous cycles are kept in the EEPROM journal
+  journal_begin();
+
+  // Start the first sequence on every machine
+  for (uint8_t index = 0; index < CHANNEL_COUNT; index++) {
+    enterSequence(channels[index], SEQUENCE_1);
+  }
+
+  // Tasks are run in this order on every pass: inputs first so the sequence always sees fresh levels
+  scheduler_addTask(task_sampleInputs, INPUT_SAMPLE_INTERVAL);
+  scheduler_addTask(task_runSequence, SEQUENCE_STEP_INTERVAL);
+  scheduler_addTask(task_refreshDisplay, SIGNAL_CHECK_INTERVAL);
+  scheduler_addTask(task_serviceSerial, SERIAL_SERVICE_INTERVAL);
+
+  // Between the passes the CPU sleeps until an interrupt, the duty cycle is measured from here
+  power_begin();
 }
 //=====================================================================================================================================================
 
 
 
 //=====================================================================================================================================================
-// Séquence 2 : Checks the signal received from the 24V DC power supply
+// Main function that runs in a loop
+//=====================================================================================================================================================
+void loop() {
+  scheduler_run();
+  power_idle();
+}
 //=====================================================================================================================================================
-void sequence_WALL_SWITCH_FEEDBACK() {
-  static bool countdownDone = false; // Variable to track if the countdown is done
 
-  // Check if the time elapsed since the last check exceeds the defined interval
-  if (millis() - lastSignalCheckTime >= SIGNAL_CHECK_INTERVAL) {
-    lastSignalCheckTime = millis(); // Update the time of the last check
 
-    lcd.clear();
 
-    // If the countdown has not been done yet
-    if (!countdownDone) {
+//=====================================================================================================================================================
+// Task: collects the debounced levels, the button presses and the captured edges
+//=====================================================================================================================================================
+void task_sampleInputs() {
+  EdgeEvent edge;
 
-    // Display the initial message on the LCD screen
-    lcd.setCursor(3, 0);
-    lcd.print("Second test :");
-    lcd.setCursor(5, 1);
-    lcd.print("Check the");
-    lcd.setCursor(2, 2);
-    lcd.print("POWER SUPPLY 24V");
+  while (edgeCapture_pop(edge)) {
+    edgeStats_add(edgeStats[edge.channel], edge);
+    telemetry_edge(edge);
+  }
 
-    // 10-second countdown
-      for (int i = 10; i > 0; i--) {
-        lcd.setCursor(4, 3);
-        lcd.print("Waiting :" + String(i) + "s ");
-        delay(1000); // Wait for one second
-      }
+  unsigned long latency;
+  uint8_t responder;
+  if (roundTrip_take(latency, responder)) {
+    roundTripStats_add(roundTripStats, latency);
+    telemetry_roundTrip(responder, latency);
+  }
 
-    // Mark that the countdown is done
-      countdownDone = true;
-    }
+  analyseCapture();
 
-    // Check the input signal state after the 10-second countdown
-    if (digitalRead(pin_Wall_switch) == LOW) {
-      lcd.clear();
-      lcd.setCursor(0, 0);
-      lcd.print("WALL SWITCH PRESENT");
-      lcd.setCursor(1, 1);
-      lcd.print("Push next button");
-      lcd.setCursor(3, 2);
-      lcd.print("if the test is");
-      lcd.setCursor(0, 3);
-      lcd.print("WALL SWITCH PRESENT");
-    } else {
-      lcd.clear();
-      lcd.setCursor(0, 0);
-      lcd.print("WALL SWITCH MISSING");
-      lcd.setCursor(1, 1);
-      lcd.print("Push next button");
-      lcd.setCursor(3, 2);
-      lcd.print("if the test is");
-      lcd.setCursor(0, 3);
-      lcd.print("WALL SWITCH PRESENT");
-      
-    }
+  if (CHANNEL_COUNT > 1) {
+    expander_update();
+  }
+  for (uint8_t index = 0; index < CHANNEL_COUNT; index++) {
+    channel_sampleInputs(channels[index]);
+  }
+
+  // A press shorter than the task period is not lost: the event stays latched until it is taken
+  if (debouncer_takePresses() & debouncer_mask(button_next_sequence)) {
+    channels[focusChannel].buttonPressed = true;
   }
 }
 //=====================================================================================================================================================
 
 
 
-
 //=====================================================================================================================================================
-// Sequence 3: Checks the signal received when the machine starts by pressing the START button
+// Task: sequence interpreter, checks the end conditions of the current step of every channel
 //=====================================================================================================================================================
-void sequence_START_SCANNER() {
-  static bool countdownDone = false; // Variable to track if the countdown is done
-  bool signalReceived = false;
-  bool buttonPressed = false;
-
-  // Check if the countdown is not already done
-  if (!countdownDone) {
-    // Display the initial message on the LCD screen
-    lcd.clear();
-    lcd.setCursor(1, 0);
-    lcd.print("Third test: check");
-    lcd.setCursor(2, 1);
-    lcd.print(" if the SCANNER");
-    lcd.setCursor(5, 2);
-    lcd.print("STARTS UP");
+void task_runSequence() {
+  for (uint8_t index = 0; index < CHANNEL_COUNT; index++) {
+    runChannel(channels[index]);
+  }
 
-    // 10-second countdown
-    for (int i = 10; i > 0; i--) {
-      lcd.setCursor(4, 3);
-      lcd.print("Waiting :" + String(i) + "s ");
-      delay(1000); // Wait for one second
+  // The operator is called to the next machine waiting for a confirmation when the focused one is not
+  if (!(channels[focusChannel].lanes[0].step.flags & STEP_CONFIRM)) {
+    for (uint8_t offset = 1; offset < CHANNEL_COUNT; offset++) {
+      uint8_t index = (focusChannel + offset) % CHANNEL_COUNT;
+      if (channels[index].lanes[0].step.flags & STEP_CONFIRM) {
+        focusChannel = index;
+        break;
+      }
     }
+  }
 
-    lcd.clear();
-    lcd.setCursor(5, 0);
-    lcd.print("IF FORCE:");
-    lcd.setCursor(1, 1);
-    lcd.print("Push next button");
-    lcd.setCursor(0, 2);
-    lcd.print("If X.CITE|CEED|GO :");
-    lcd.setCursor(0, 3);
-    lcd.print("Push little button");
-
-    // Marking that the countdown is complete
-    countdownDone = true;
-  }
-
-  // Loop to remain in this sequence until a condition is met
-  while (!signalReceived && !buttonPressed) {
-    // Check if a LOW signal is detected
-    if (digitalRead(pin_Start) == LOW) {
-      // Clear the LCD screen
-      lcd.clear();
-      // Display a message indicating that the signal has been received
-      lcd.setCursor(2, 0);
-      lcd.print("GANTRY SHOULD BE");
-      lcd.setCursor(6, 1);
-      lcd.print("ENERGIZED");
-      lcd.setCursor(0, 2);
-      lcd.print("Push next button if");
-      lcd.setCursor(0, 3);
-      lcd.print("Gantry is ENERGIZED");
-
-      // Wait for the button press to move to the next sequence or the next step
-      while (digitalRead(button_next_sequence) == HIGH) {
-        // Wait
-      }
-        // Wait for a short moment to avoid bouncing
-      delay(1000);
-        // Wait for the button to be released
-      while (digitalRead(button_next_sequence) == LOW) {
-        // Wait
-      }
+  appendQueuedRecord();
+}
 
-      signalReceived = true; // Mark that the signal has been received
-    }
+// The lanes of a group have the same step layout: the flags, timings and transitions of lane 0 drive them all, each
+// lane only brings its own input.
+void runChannel(Channel& channel) {
+  SequenceLane* lanes = channel.lanes;
+  const StepDescriptor& step = lanes[0].step;
 
-    // Check if the next button is pressed
-    if (digitalRead(button_next_sequence) == LOW) {
-      // Clear the LCD screen
-      lcd.clear();
-      // Display a message indicating that the button has been pressed
-      lcd.setCursor(3, 0);
-      lcd.print("Test force:");
-      lcd.setCursor(2, 1);
-      lcd.print("Push the GREEN");
-      lcd.setCursor(5, 2);
-      lcd.print("button on");
-      lcd.setCursor(0, 3);
-      lcd.print("electrical cabinet");
-
-      delay(10000);
-
-      // Display another message
-      lcd.clear();
-      lcd.setCursor(3, 0);
-      lcd.print("Did the Force");
-      lcd.setCursor(2, 1);
-      lcd.print("system start up");
-      lcd.setCursor(0, 2);
-      lcd.print("without any problem?");
-      lcd.setCursor(1, 3);
-      lcd.print("If YES: push next");
-
-      // Wait for the button press to move to the next sequence or the next step
-      while (digitalRead(button_next_sequence) == HIGH) {
-        // Wait
-      }
-        // Wait for a short moment to avoid bouncing
-      delay(1000);
-        // Wait for the button to be released
-      while (digitalRead(button_next_sequence) == LOW) {
-        // Wait
+  // Passive check: the verdict follows the input until the operator moves on, the group summary shows every lane
+  if ((step.flags & STEP_SHOW_LEVEL) && channel.laneCount == 1) {
+    showScreen(channel, channel_inputLevel(channel, step.pin) == step.level ? step.screen : step.failScreen);
+  }
+
+  if ((step.flags & STEP_WAIT_LEVEL) && channel_inputLevel(channel, step.pin) == step.level) {
+    lanes[0].verdict = VERDICT_OK;
+    enterStep(channel, step.next);
+    return;
+  }
+
+  // Presses are ignored by the steps that do not ask for a confirmation, one press confirms every lane
+  if (consumeButtonPress(channel) && (step.flags & STEP_CONFIRM)) {
+    for (uint8_t index = 0; index < channel.laneCount; index++) {
+      SequenceLane& lane = lanes[index];
+      if (step.flags & STEP_SHOW_LEVEL) {
+        lane.verdict = channel_inputLevel(channel, lane.step.pin) == lane.step.level ? VERDICT_OK : VERDICT_NOK;
+      } else if (step.flags & STEP_WAIT_LEVEL) {
+        lane.verdict = VERDICT_NO_SIGNAL;
       }
-      buttonPressed = true; // Mark that the button has been pressed
     }
+    enterStep(channel, step.onPress);
+    return;
   }
 
-  // Once one of the conditions is met, proceed to the next sequence
-  currentSequence = SEQUENCE_4;
+  // Adaptive countdown: it ends as soon as every input has been stable long enough, the timeout stays the upper bound
+  if (step.settle > 0 && lanesSettled(channel)) {
+    recordSettleTimes(channel);
+    enterStep(channel, step.next);
+    return;
+  }
+
+  if (step.seconds > 0 && countdownFinished(channel)) {
+    // In a group, the lanes that did settle before the timeout keep their settle time
+    recordSettleTimes(channel);
+    enterStep(channel, step.next);
+  }
 }
 //=====================================================================================================================================================
 
 
 
 //=====================================================================================================================================================
-// Sequence 4: Checks the signal received when the machine sends a scanner shutdown request after pressing the stop button
+// Task: redraws the requested screen in the shadow framebuffer and sends the characters that changed
+//=====================================================================================================================================================
+void task_refreshDisplay() {
+  const Channel& channel = channels[focusChannel];
+  // The previous frame is still on its way to the LCD, the screen is drawn again once it has arrived
+  if (channel.screen >= SCREEN_COUNT || !lcd_idle()) {
+    return;
+  }
+  display.clear();
+  drawScreen(channel, channel.screen);
+  // With several machines, the last character of the first row tells which one the screen is about
+  if (CHANNEL_COUNT > 1) {
+    display.setCursor(LCD_COLUMNS - 1, 0);
+    display.print((char)('1' + channel.index));
+  }
+  display.sendChanges();
+}
 //=====================================================================================================================================================
-void sequence_SHUTDOWN_REQUEST() {
-  static bool countdownDone = false; // Variable to track if the countdown is done
-  static bool signalReceived = false; // Variable to track if a signal is received
 
-  // Check if the time elapsed since the last check exceeds the defined interval
-  if (millis() - lastSignalCheckTime >= SIGNAL_CHECK_INTERVAL) {
-    // Update the time of the last check
-    lastSignalCheckTime = millis();
-    lcd.clear();
 
-    // If the countdown is not yet done
-    if (!countdownDone) {
-      // Display initial message on the LCD screen
-      lcd.setCursor(4, 0);
-      lcd.print("Fourth test :");
-      lcd.setCursor(6, 1);
-      lcd.print("Check the");
-      lcd.setCursor(2, 2);
-      lcd.print("SHUTDOWN REQUEST");
 
-      // 10-second countdown
-      for (int i = 10; i > 0; i--) {
-        lcd.setCursor(4, 3);
-        lcd.print("Waiting :" + String(i) + "s ");
-        delay(1000); // Wait for one second
+//=====================================================================================================================================================
+// Task: serial commands and journal dump
+//=====================================================================================================================================================
+// The dump refills the transmit ring as it drains, so the records leave back to back at the line rate without
+// ever blocking the loop. A command split from its argument waits in pendingCommand for the next byte.
+void task_serviceSerial() {
+  int command;
+  while ((command = uart_read()) >= 0) {
+    Channel& channel = channels[remoteChannel];
+    uint8_t argument = command - '1';
+    if (pendingCommand == COMMAND_START) {
+      pendingCommand = 0;
+      bool valid = argument < SEQUENCE_COUNT;
+      if (valid) {
+        skipSequence(channel, argument);
       }
-
-      // Mark that the countdown is complete
-      countdownDone = true;
-    }
-    // Display message before checking button state
-      lcd.clear();
-      lcd.setCursor(0, 0);
-      lcd.print("Push the RED BUTTON");
-      lcd.setCursor(3, 1);
-      lcd.print("on electrical");
-      lcd.setCursor(6, 2);
-      lcd.print("cabinet");
-
-    // Check if the next button is pressed
-    if (digitalRead(button_next_sequence) == LOW) {
-      // Wait for the button to be released
-      while (digitalRead(button_next_sequence) == LOW) {
-        // Wait
+      telemetry_commandAck(COMMAND_START, valid, telemetry_sequenceField(channel.index, channel.sequence));
+    } else if (pendingCommand == COMMAND_CHANNEL) {
+      pendingCommand = 0;
+      bool valid = argument < CHANNEL_COUNT;
+      if (valid) {
+        remoteChannel = argument;
       }
-      // Proceed to the next sequence
-      currentSequence = SEQUENCE_5;
-    }
-
-    // If a signal is received
-    if (digitalRead(pin_Shutdown_request) == HIGH) {
-      // Display message when the received signal is LOW
-      lcd.clear();
-      lcd.setCursor(0, 0);
-      lcd.print("SHUTDOWN REQUEST OK");
-      lcd.setCursor(2, 1);
-      lcd.print("If the test is :");
-      lcd.setCursor(0, 2);
-      lcd.print("Shutdown request OK");
-      lcd.setCursor(0, 3);
-      lcd.print("=> Push next button");
-      // Wait for the button press to move to the next sequence or the next step
-      while (digitalRead(button_next_sequence) == HIGH) {
-        // Wait
+      const Channel& selected = channels[remoteChannel];
+      telemetry_commandAck(COMMAND_CHANNEL, valid, telemetry_sequenceField(selected.index, selected.sequence));
+    } else if (command == COMMAND_START || command == COMMAND_CHANNEL) {
+      pendingCommand = command;
+    } else if (command == COMMAND_CONFIRM) {
+      // Latched like a press, consumed by the next run of the sequence task
+      bool accepted = (channel.lanes[0].step.flags & STEP_CONFIRM) != 0;
+      channel.buttonPressed = channel.buttonPressed || accepted;
+      telemetry_commandAck(COMMAND_CONFIRM, accepted, telemetry_sequenceField(channel.index, channel.sequence));
+    } else if (command == COMMAND_SKIP) {
+      skipSequence(channel, (channel.sequence + channel.laneCount) % SEQUENCE_COUNT);
+      telemetry_commandAck(COMMAND_SKIP, true, telemetry_sequenceField(channel.index, channel.sequence));
+    } else if (command == COMMAND_STATUS) {
+      uint8_t levels = 0;
+      for (uint8_t index = 0; index < sizeof(STATUS_PINS); index++) {
+        uint8_t pin = STATUS_PINS[index];
+        if ((pin == button_next_sequence ? channel.inputs.button : channel_inputLevel(channel, pin)) == HIGH) {
+          levels |= 1 << pin;
+        }
       }
-        // Wait for a short moment to avoid bouncing
-      delay(1000);
-        // Wait for the button to be released
-      while (digitalRead(button_next_sequence) == LOW) {
-        // Wait
+      uint16_t countdown = channel.countdownValue > 0xFFFF ? 0xFFFF : channel.countdownValue;
+      telemetry_status(telemetry_sequenceField(channel.index, channel.sequence), channel.stepIndex, channel.screen,
+                       levels, channel_outputLevel(channel, out_pin_Shutdown_command), countdown);
+    } else if (command == COMMAND_RESULTS) {
+      telemetry_cycleRecord(channel.cycleRecord);
+    } else if (command == COMMAND_RECORD_INPUTS) {
+      // The replay starts from the same state: the beginning of sequence 1 at the start of the trace. Only the
+      // Uno pins are recorded, the trace is the one of channel 0
+      skipSequence(channels[0], SEQUENCE_1);
+      inputTrace_start();
+      inputTraceEnding = false;
+      telemetry_inputTraceStart(inputTrace_startTime(), inputTrace_startLevels());
+      telemetry_commandAck(COMMAND_RECORD_INPUTS, true, channels[0].sequence);
+    } else if (command == COMMAND_STOP_RECORDING) {
+      bool accepted = inputTrace_recording();
+      if (accepted) {
+        inputTrace_stop();
+        inputTraceEnding = true;
       }
-      currentSequence = SEQUENCE_5;
+      telemetry_commandAck(COMMAND_STOP_RECORDING, accepted, channels[0].sequence);
+    } else if (command == COMMAND_POWER) {
+      PowerStats stats;
+      power_takeStats(stats);
+      telemetry_powerStats(stats);
+    } else if (command == COMMAND_DUMP_JOURNAL && !journalDumping) {
+      journalDumping = true;
+      journalDumpSlot = 0;
+      journalDumpCount = 0;
+    } else if (command == COMMAND_SEND_TRACE && waveCapture_done() && !traceSending) {
+      traceSending = true;
+      traceOffset = 0;
+    }
+  }
+
+  InputTransition transition;
+  while (uart_txFree() >= TELEMETRY_FRAME_OVERHEAD + TELEMETRY_MAX_PAYLOAD && inputTrace_take(transition)) {
+    telemetry_inputTransition(transition);
+  }
+  if (inputTraceEnding && !inputTrace_pending() && uart_txFree() >= TELEMETRY_FRAME_OVERHEAD + TELEMETRY_MAX_PAYLOAD) {
+    telemetry_inputTraceEnd(inputTrace_transitions(), inputTrace_overflows());
+    inputTraceEnding = false;
+  }
+
+  while (traceSending && uart_txFree() >= TELEMETRY_FRAME_OVERHEAD + TELEMETRY_MAX_PAYLOAD) {
+    uint8_t length = CAPTURE_BUFFER_SIZE - traceOffset;
+    if (length > TRACE_BYTES_PER_FRAME) {
+      length = TRACE_BYTES_PER_FRAME;
+    }
+    telemetry_captureTrace(traceOffset, length);
+    traceOffset += length;
+    traceSending = traceOffset < CAPTURE_BUFFER_SIZE;
+  }
+
+  // The EEPROM cannot be read while a record is being written
+  while (journalDumping && !journal_busy() &&
+         uart_txFree() >= TELEMETRY_FRAME_OVERHEAD + JOURNAL_RECORD_SIZE) {
+    if (journalDumpSlot == JOURNAL_CAPACITY) {
+      telemetry_journalEnd(journalDumpCount);
+      journalDumping = false;
+      break;
+    }
+    JournalRecord record;
+    if (journal_read(journalDumpSlot++, record)) {
+      telemetry_journalRecord(record);
+      journalDumpCount++;
     }
   }
 }
@@ -438,109 +469,393 @@ void sequence_SHUTDOWN_REQUEST() {
 
 
 //=====================================================================================================================================================
-// Sequence 5: Controls the output to the relay
+// Helpers shared by the sequences
 //=====================================================================================================================================================
-void sequence_SHUTDOWN_COMMAND() {
-  lcd.clear();
-  lcd.setCursor(2, 0);
-  lcd.print("The system will");
-  lcd.setCursor(3, 1);
-  lcd.print("shut down in :");
+// Moves a channel to another sequence, which restarts at its first step together with the passive sequences that
+// follow it
+void enterSequence(Channel& channel, uint8_t next) {
+  channel.sequence = next;
+  if (next == SEQUENCE_1) {
+    // Provisional run counter, the one of the record is given when it is written
+    journalRecord_clear(channel.cycleRecord, journal_nextRun());
+    channel.cycleRecord.bounces = channel.index << JOURNAL_CHANNEL_SHIFT;
+  }
+  channel.laneCount = groupSize(next);
+  channel.sequenceStartTime = hal_millis();
+  channel.roundTripTimed = false;
+  for (uint8_t index = 0; index < channel.laneCount; index++) {
+    SequenceLane& lane = channel.lanes[index];
+    lane.sequence = next + index;
+    lane.verdict = VERDICT_CONFIRMED;
+    lane.settleTime = SETTLE_NONE;
+    telemetry_sequenceStart(telemetry_sequenceField(channel.index, lane.sequence));
+    uint8_t edgeChannel = sequenceTable_edgeChannel(lane.sequence);
+    if (channel_timed(channel) && edgeChannel < EDGE_CHANNEL_COUNT) {
+      // The response time is measured from the moment the operator is asked to act
+      edgeStats_reset(edgeStats[edgeChannel], hal_micros());
+    }
+  }
+  startStep(channel, 0);
+}
+
+// Number of sequences run together from the given one: the passive sequences that follow each other, up to LANE_MAX
+uint8_t groupSize(uint8_t first) {
+  uint8_t size = 1;
+  while (size < LANE_MAX && first + size < SEQUENCE_COUNT && sequenceTable_summary(first) != MSG_NONE &&
+         sequenceTable_summary(first + size) != MSG_NONE) {
+    size++;
+  }
+  return size;
+}
+
+// Starts a step of the current sequences, STEP_END moves to the sequence after them
+void enterStep(Channel& channel, uint8_t index) {
+  leaveStep(channel);
+  if (index == STEP_END) {
+    finishSequence(channel);
+    enterSequence(channel, (channel.sequence + channel.laneCount) % SEQUENCE_COUNT);
+    return;
+  }
+  startStep(channel, index);
+}
 
-  // Countdown of 20 seconds
-  for (int i = 20; i > 0; i--) {
-    lcd.setCursor(9, 2);
-    lcd.print(String(i) + "s ");
-    delay(1000); // Wait for one second
+// Reads and starts a step, kept apart from enterStep() so the sequence changes do not recurse: the footprint target
+// bounds the stack from the call graph
+void startStep(Channel& channel, uint8_t index) {
+  channel.stepIndex = index;
+  for (uint8_t lane = 0; lane < channel.laneCount; lane++) {
+    sequenceTable_readStep(channel.lanes[lane].sequence, index, channel.lanes[lane].step);
+    channel.lanes[lane].settling = false;
   }
 
-  bool signalReceived = false;
+  // On the expander channels the shutdown command is only driven: its response is not timed
+  const StepDescriptor& step = channel.lanes[0].step;
+  if ((step.flags & STEP_CAPTURE) && channel_timed(channel)) {
+    waveCapture_arm(step.level);
+    captureAnalysed = false;
+    captureSequence = channel.lanes[0].sequence;
+  }
+  if ((step.flags & STEP_TIME_RESPONSE) && channel_timed(channel)) {
+    roundTrip_drive(step.level);
+    channel.roundTripTimed = true;
+  } else if (step.flags & STEP_DRIVE_OUTPUT) {
+    channel_writeOutput(channel, step.pin, step.level);
+  }
+  if (step.seconds > 0) {
+    startCountdown(channel, step.seconds);
+  }
+  showScreen(channel, channel.laneCount > 1 ? step.groupScreen : step.screen);
+  if (channel_timed(channel)) {
+    showCaptureResult(channel);
+  }
+  channel.buttonPressed = false;
+}
 
-  // Wait for the HIGH signal reception on pin_Start
-  while (!signalReceived) {
-    digitalWrite(out_pin_Shutdown_command, HIGH); //  Set the output pin to HIGH state
-    lcd.clear();
-    lcd.setCursor(2, 0);
-    lcd.print("Did the system ");
-    lcd.setCursor(1, 1);
-    lcd.print("shut down without");
-    lcd.setCursor(4, 2);
-    lcd.print("any problem ?");
-    lcd.setCursor(0, 3);
-    lcd.print("If YES : push next!");
+// Ends the running step of the current sequences
+void leaveStep(Channel& channel) {
+  // A timed command still waiting for its response when the step ends got none
+  if (channel.roundTripTimed && (channel.lanes[0].step.flags & STEP_TIME_RESPONSE) && roundTrip_cancel()) {
+    roundTripStats_miss(roundTripStats);
+  }
+}
 
-    // Wait for the button press to move to the next sequence or the next step
-    while (digitalRead(button_next_sequence) == HIGH) {
-        // Wait
+// Ends the current sequences before their checks, on a remote command, and starts the given one
+void skipSequence(Channel& channel, uint8_t next) {
+  leaveStep(channel);
+  // The shutdown command must not stay driven when sequence 5 is left half-way
+  channel_writeOutput(channel, out_pin_Shutdown_command, LOW);
+  for (uint8_t index = 0; index < channel.laneCount; index++) {
+    channel.lanes[index].verdict = VERDICT_SKIPPED;
+  }
+  finishSequence(channel);
+  enterSequence(channel, next);
+}
+
+// Reports the results of the current sequences
+void finishSequence(Channel& channel) {
+  if (channel_timed(channel)) {
+    // A trace completed since the last pass still decides the verdict, a capture that did not trigger, or did not
+    // finish before the operator moved on, is dropped
+    analyseCapture();
+    if (waveCapture_armed()) {
+      waveCapture_stop();
     }
-    // Wait for a short moment to avoid bouncing
-    delay(1000);
-    // Wait for the button to be released
-    while (digitalRead(button_next_sequence) == LOW) {
-        // Wait
+    if (channel.roundTripTimed) {
+      telemetry_roundTripStats(roundTripStats);
     }
-    // Signal received and button pressed, move to the next sequence or the next step
-    signalReceived = true;
-    lcd.clear();
-
-    lcd.setCursor(0, 0);
-    lcd.print("SHUTDOWN COMMAND OK");
-    lcd.setCursor(1, 1);
-    lcd.print("If the test is :");
-    lcd.setCursor(0, 2);
-    lcd.print("Shutdown command OK");
-    lcd.setCursor(0, 3);
-    lcd.print("=> Push next button");
-
-    
-    // Send a LOW signal on the same pin
-    digitalWrite(out_pin_Shutdown_command, LOW);
-
-    // Wait for the button press to move to the next sequence or the next step
-    while (digitalRead(button_next_sequence) == HIGH) {
-        // Wait
+  }
+  for (uint8_t index = 0; index < channel.laneCount; index++) {
+    SequenceLane& lane = channel.lanes[index];
+    uint8_t edgeChannel = sequenceTable_edgeChannel(lane.sequence);
+    if (channel_timed(channel) && edgeChannel < EDGE_CHANNEL_COUNT) {
+      telemetry_edgeStats(lane.sequence, edgeChannel, edgeStats[edgeChannel]);
     }
-    // Wait for a short moment to avoid bouncing
-    delay(1000);
-    // Wait for the button to be released
-    while (digitalRead(button_next_sequence) == LOW) {
-        // Wait
+    // A glitching contact fails the check even though the line reached its level
+    if (channel_timed(channel) && lane.sequence == captureSequence) {
+      if (captureAnalysed && captureStats.glitches > 0 && lane.verdict == VERDICT_OK) {
+        lane.verdict = VERDICT_NOK;
+      }
+      captureSequence = SEQUENCE_COUNT;
     }
+    recordResults(channel, lane);
+    telemetry_sequenceEnd(telemetry_sequenceField(channel.index, lane.sequence), lane.verdict,
+                          hal_millis() - channel.sequenceStartTime, lane.settleTime);
+  }
+}
 
-    lcd.clear();
-    lcd.setCursor(4, 0);
-    lcd.print("FINAL TEST:");
-    lcd.setCursor(0, 1);
-    lcd.print("Check the indicator");
-    lcd.setCursor(0, 2);
-    lcd.print("lights for X_RAY ON");
-    lcd.setCursor(2, 3);
-    lcd.print("and X_RAY READY");
-
-    delay(5000);
-
-    lcd.clear();
-    lcd.setCursor(0, 0);
-    lcd.print("If the X-RAY tests");
-    lcd.setCursor(2, 1);
-    lcd.print("are completed :");
-    lcd.setCursor(0, 2);
-    lcd.print("Press next button &");
-    lcd.setCursor(0, 3);
-    lcd.print("TURN OFF the casing");
-  
-    // Wait for the button press to move to the next sequence or the next step
-    while (digitalRead(button_next_sequence) == HIGH) {
-        // Wait
+// Copies the results of a sequence into the cycle record of the channel, which is journaled after the last sequence
+void recordResults(Channel& channel, const SequenceLane& lane) {
+  JournalRecord& record = channel.cycleRecord;
+  journalRecord_setVerdict(record, lane.sequence, lane.verdict);
+
+  uint8_t edgeChannel = sequenceTable_edgeChannel(lane.sequence);
+  if (channel_timed(channel) && edgeChannel < EDGE_CHANNEL_COUNT && edgeStats[edgeChannel].edges > 0) {
+    const EdgeStats& stats = edgeStats[edgeChannel];
+    uint16_t response = journalRecord_time(edgeStats_responseTime(stats) / 1000UL);
+    uint16_t settle = journalRecord_time(edgeStats_settleTime(stats));
+    uint8_t bounces = stats.bounces > JOURNAL_BOUNCES_MAX ? JOURNAL_BOUNCES_MAX : stats.bounces;
+    if (edgeChannel == EDGE_EMERGENCY) {
+      record.emergencyResponse = response;
+      record.emergencySettle = settle;
+      record.bounces = (record.bounces & ~JOURNAL_BOUNCES_MAX) | bounces;
+    } else {
+      record.wallSwitchResponse = response;
+      record.wallSwitchSettle = settle;
+      record.bounces = (record.bounces & ~(JOURNAL_BOUNCES_MAX << JOURNAL_BOUNCE_BITS)) | (bounces << JOURNAL_BOUNCE_BITS);
     }
-    // Wait for a short moment to avoid bouncing
-    delay(1000);
-    // Wait for the button to be released
-    while (digitalRead(button_next_sequence) == LOW) {
-        // Wait
+  }
+  if (channel.roundTripTimed && roundTripStats.last != ROUND_TRIP_NONE) {
+    record.roundTrip = journalRecord_time(roundTripStats.last / 100UL);
+  }
+
+  if (lane.sequence == SEQUENCE_COUNT - 1) {
+    queueRecord(record);
+  }
+}
+
+// Analyses a complete trace once, for the result screen, the telemetry and the verdict of the capturing sequence
+void analyseCapture() {
+  if (!waveCapture_done() || captureAnalysed) {
+    return;
+  }
+  waveCapture_analyse(captureStats);
+  captureAnalysed = true;
+  telemetry_captureStats(captureStats);
+  showCaptureResult(channels[0]);
+}
+
+// A result step of the capturing sequence shows its failScreen once the trace has glitches
+void showCaptureResult(Channel& channel) {
+  const StepDescriptor& step = channel.lanes[0].step;
+  if (captureAnalysed && captureStats.glitches > 0 && channel.lanes[0].sequence == captureSequence &&
+      !(step.flags & (STEP_SHOW_LEVEL | STEP_CAPTURE)) && step.failScreen < SCREEN_COUNT) {
+    showScreen(channel, step.failScreen);
+  }
+}
+
+// Queues a finished cycle record for the journal, several machines can end their cycle while a record is written
+void queueRecord(const JournalRecord& record) {
+  if (journalQueued < CHANNEL_COUNT) {
+    journalQueue[journalQueued++] = record;
+  }
+  appendQueuedRecord();
+}
+
+// Writes the oldest queued record once the EEPROM is free
+void appendQueuedRecord() {
+  if (journalQueued == 0 || journal_busy()) {
+    return;
+  }
+  // The run counters follow the order of the writes, which the journal needs to find the newest record
+  journalQueue[0].run = journal_nextRun();
+  journal_append(journalQueue[0]);
+  journalQueued--;
+  for (uint8_t index = 0; index < journalQueued; index++) {
+    journalQueue[index] = journalQueue[index + 1];
+  }
+}
+
+// Returns true once per debounced press of button_next_sequence on the focused channel, or remote confirmation
+bool consumeButtonPress(Channel& channel) {
+  bool pressed = channel.buttonPressed;
+  channel.buttonPressed = false;
+  return pressed;
+}
+
+// Requests a screen, it is drawn by task_refreshDisplay() while the channel has the focus
+void showScreen(Channel& channel, uint8_t screen) {
+  channel.screen = screen;
+}
+
+// Starts a countdown of the given number of seconds on the current step
+void startCountdown(Channel& channel, unsigned long seconds) {
+  timer_start(channel.stepTimer, seconds * 1000UL);
+  channel.countdownValue = seconds;
+}
+
+// Updates the displayed value and returns true when the countdown is over
+bool countdownFinished(Channel& channel) {
+  channel.countdownValue = timer_remainingSeconds(channel.stepTimer);
+  return timer_expired(channel.stepTimer);
+}
+
+// Returns true once the input of the lane has held its expected level for the stability window
+bool inputSettled(const Channel& channel, SequenceLane& lane) {
+  if (channel_inputLevel(channel, lane.step.pin) != lane.step.level) {
+    lane.settling = false;
+    return false;
+  }
+  unsigned long now = hal_millis();
+  if (!lane.settling) {
+    lane.settling = true;
+    lane.settleStart = now;
+  }
+  return now - lane.settleStart >= lane.step.settle * 100UL;
+}
+
+// Returns true once every lane has settled, each one keeps its own stability window
+bool lanesSettled(Channel& channel) {
+  bool settled = true;
+  for (uint8_t index = 0; index < channel.laneCount; index++) {
+    settled &= inputSettled(channel, channel.lanes[index]);
+  }
+  return settled;
+}
+
+// Keeps the time each settled input of the current step took to reach its level, from the start of the step
+void recordSettleTimes(Channel& channel) {
+  unsigned long now = hal_millis();
+  for (uint8_t index = 0; index < channel.laneCount; index++) {
+    SequenceLane& lane = channel.lanes[index];
+    if (lane.step.settle > 0 && lane.settling && now - lane.settleStart >= lane.step.settle * 100UL) {
+      lane.settleTime = lane.settleStart - channel.stepTimer.start;
+    }
+  }
+}
+
+// Prints a message from the flash table at the given position
+void printMessage(uint8_t column, uint8_t row, MessageId id) {
+  display.setCursor(column, row);
+  message_print(display, id);
+}
+
+// Prints a number with a MSG_FORMAT_ message at the given position
+void printFormatted(uint8_t column, uint8_t row, MessageId format, unsigned long value) {
+  display.setCursor(column, row);
+  message_printFormatted(display, format, value);
+}
+
+// Prints the edge timing of a passive check on one row: R = response time, S = settle time, B = bounces
+void printEdgeStats(uint8_t row, const EdgeStats& stats) {
+  if (stats.edges == 0) {
+    printMessage(0, row, MSG_NO_EDGE_CAPTURED);
+  } else {
+    display.setCursor(0, row);
+    message_printFormatted(display, MSG_FORMAT_EDGE_STATS,
+                           edgeStats_responseTime(stats) / 1000UL, edgeStats_settleTime(stats), stats.bounces);
+  }
+}
+
+// Prints one row of the round-trip latency statistics, in ms
+void printRoundTrip(uint8_t row, MessageId format) {
+  const RoundTripStats& stats = roundTripStats;
+  display.setCursor(0, row);
+  switch (format) {
+    case MSG_FORMAT_ROUND_TRIP_STATS:
+      if (stats.count == 0) {
+        message_print(display, MSG_NO_RESPONSE);
+      } else {
+        message_printFormatted(display, format, stats.minimum / 1000UL, stats.mean / 1000UL, stats.maximum / 1000UL,
+                               stats.count);
+      }
+      break;
+    case MSG_FORMAT_ROUND_TRIP_LAST:
+      if (stats.last == ROUND_TRIP_NONE) {
+        message_print(display, MSG_LAST_NO_RESPONSE);
+      } else {
+        message_printFormatted(display, format, stats.last / 1000UL);
+      }
+      break;
+    default: {
+      // One character per bin, from < 1 ms to >= 64 ms: the count, or '+' above 9
+      char bins[ROUND_TRIP_BINS + 1];
+      for (uint8_t bin = 0; bin < ROUND_TRIP_BINS; bin++) {
+        bins[bin] = stats.histogram[bin] > 9 ? '+' : '0' + stats.histogram[bin];
+      }
+      bins[ROUND_TRIP_BINS] = '\0';
+      message_printFormatted(display, format, bins);
+      break;
+    }
+  }
+}
+
+// Prints the analysis of the shutdown request trace: E = edges, G = glitches, then the shortest and longest levels
+void printCaptureStats(uint8_t row) {
+  if (!captureAnalysed) {
+    printMessage(0, row, MSG_CAPTURING);
+  } else if (captureStats.edges < 2) {
+    printMessage(0, row, MSG_CLEAN_EDGE);
+  } else {
+    display.setCursor(0, row);
+    message_printFormatted(display, MSG_FORMAT_CAPTURE_STATS, captureStats.edges, captureStats.glitches,
+                           captureStats.minWidth, captureStats.maxWidth);
+  }
+}
+
+// Prints one check of the running group: its name, its verdict that follows the input, and its response time
+void printCheckSummary(const Channel& channel, uint8_t row, const SequenceLane& lane) {
+  printMessage(0, row, (MessageId)sequenceTable_summary(lane.sequence));
+  printMessage(8, row, channel_inputLevel(channel, lane.step.pin) == lane.step.level ? MSG_OK : MSG_NOK);
+  uint8_t edgeChannel = sequenceTable_edgeChannel(lane.sequence);
+  if (!channel_timed(channel) || edgeChannel >= EDGE_CHANNEL_COUNT || edgeStats[edgeChannel].edges == 0) {
+    printMessage(12, row, MSG_NO_EDGE);
+  } else {
+    printFormatted(12, row, MSG_FORMAT_CHECK_SUMMARY, edgeStats_responseTime(edgeStats[edgeChannel]) / 1000UL);
+  }
+}
+
+// Draws a screen of the table, the MSG_FORMAT_ rows are filled with the live values of the current step. The timing
+// rows need the interrupts of the Uno pins, they stay blank on the expander channels
+void drawScreen(const Channel& channel, uint8_t screen) {
+  ScreenDescriptor descriptor;
+  sequenceTable_readScreen(screen, descriptor);
+  uint8_t summaryLane = 0;
+
+  for (uint8_t row = 0; row < LCD_ROWS; row++) {
+    const ScreenLine& line = descriptor.lines[row];
+    switch (line.message) {
+      case MSG_NONE:
+        break;
+      case MSG_FORMAT_WAITING:
+      case MSG_FORMAT_SECONDS:
+        printFormatted(line.column, row, (MessageId)line.message, channel.countdownValue);
+        break;
+      case MSG_FORMAT_EDGE_STATS:
+        if (channel_timed(channel)) {
+          printEdgeStats(row, edgeStats[sequenceTable_edgeChannel(channel.sequence)]);
+        }
+        break;
+      case MSG_FORMAT_ROUND_TRIP_STATS:
+      case MSG_FORMAT_ROUND_TRIP_LAST:
+      case MSG_FORMAT_ROUND_TRIP_HISTOGRAM:
+        if (channel_timed(channel)) {
+          printRoundTrip(row, (MessageId)line.message);
+        }
+        break;
+      case MSG_FORMAT_CAPTURE_STATS:
+        if (channel_timed(channel)) {
+          printCaptureStats(row);
+        }
+        break;
+      case MSG_FORMAT_CHECK_SUMMARY:
+        if (summaryLane < channel.laneCount) {
+          printCheckSummary(channel, row, channel.lanes[summaryLane++]);
+        }
+        break;
+      default:
+        printMessage(line.column, row, (MessageId)line.message);
+        break;
     }
-    // Signal received and button pressed, move to the next sequence or the next step
-    currentSequence = SEQUENCE_1;
   }
 }
 //=====================================================================================================================================================
@@ -0,0 +1,645 @@
+//=====================================================================================================================================================
+// Native tests: the complete five-sequence run on the simulated box
+//=====================================================================================================================================================
+// The tests follow one operator session and must run in this order: each one starts where the previous one stopped.
+// The virtual clock only moves in runFor(), so the ~70 s of countdowns take a few milliseconds of real time.
+//=====================================================================================================================================================
+#include <unity.h>
+#include "Hal.h"
+#include "Channel.h"
+#include "Debouncer.h"
+#include "Journal.h"
+#include "LcdI2c.h"
+#include "Pins.h"
+#include "SequenceTable.h"
+#include "Telemetry.h"
+#include "Uart.h"
+#include "WaveCapture.h"
+
+void setup();
+void loop();
+extern Channel channels[CHANNEL_COUNT];
+
+static unsigned long setupEnd = 0;                // Virtual time at the end of setup(), after the LCD power-up delays
+static uint8_t telemetryStream[256];              // Telemetry bytes collected by the first tests
+static size_t telemetrySize = 0;
+
+
+
+//=====================================================================================================================================================
+// Helpers
+//=====================================================================================================================================================
+// Runs loop() while the virtual clock advances in 500 us steps
+static void runFor(unsigned long milliseconds) {
+  for (unsigned long i = 0; i < milliseconds * 2; i++) {
+    sim_advanceMicros(500);
+    loop();
+  }
+}
+
+// Presses and releases the next button, each level held long enough for the debouncer
+static void pressNextButton() {
+  sim_setPin(button_next_sequence, LOW);
+  runFor(100);
+  sim_setPin(button_next_sequence, HIGH);
+  runFor(100);
+}
+
+// Sends a remote-control command, as the line PC does
+static void sendCommand(const char* command) {
+  sim_uartReceive((const uint8_t*)command, strlen(command));
+}
+
+// Collects the telemetry sent so far, before the transmit ring fills up
+static void takeTelemetry() {
+  telemetrySize += sim_uartTake(&telemetryStream[telemetrySize], sizeof(telemetryStream) - telemetrySize);
+}
+
+static void assertScreen(const char* row0, const char* row1, const char* row2, const char* row3) {
+  TEST_ASSERT_EQUAL_STRING(row0, sim_lcdRow(0));
+  TEST_ASSERT_EQUAL_STRING(row1, sim_lcdRow(1));
+  TEST_ASSERT_EQUAL_STRING(row2, sim_lcdRow(2));
+  TEST_ASSERT_EQUAL_STRING(row3, sim_lcdRow(3));
+}
+
+struct DecodedFrame {
+  uint8_t type;
+  uint8_t length;
+  uint8_t payload[TELEMETRY_MAX_PAYLOAD];
+};
+
+// Splits a telemetry stream into its frames, checking the sync byte and the CRC of each
+static uint8_t decodeFrames(const uint8_t* stream, size_t size, DecodedFrame* frames, uint8_t maxFrames) {
+  uint8_t count = 0;
+  size_t position = 0;
+  while (position < size && count < maxFrames) {
+    TEST_ASSERT_EQUAL(TELEMETRY_SYNC, stream[position]);
+    DecodedFrame& frame = frames[count++];
+    frame.type = stream[position + 1];
+    frame.length = stream[position + 2];
+    memcpy(frame.payload, &stream[position + 3], frame.length);
+    uint16_t crc = stream[position + 3 + frame.length] | (stream[position + 4 + frame.length] << 8);
+    TEST_ASSERT_EQUAL(telemetry_crc16(0xFFFF, &stream[position + 1], frame.length + 2), crc);
+    position += frame.length + 5;
+  }
+  TEST_ASSERT_EQUAL(size, position);
+  return count;
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Sequences 1 and 2 run together: shared countdown, then a summary whose verdicts follow the E-stop and wall-switch
+// inputs, and a single confirmation for both
+//=====================================================================================================================================================
+void test_passive_checks() {
+  runFor(500);
+  assertScreen("    First tests :   ",
+               "   EMERGENCY STOP   ",
+               "  POWER SUPPLY 24V  ",
+               "    Waiting :10s    ");
+
+  // The operator pushes the E-stop 3 s after the prompt, the contact bounces twice within 400 us
+  runFor(2500);
+  sim_setPin(pin_Emergency, LOW);
+  sim_advanceMicros(200);
+  sim_setPin(pin_Emergency, HIGH);
+  sim_advanceMicros(200);
+  sim_setPin(pin_Emergency, LOW);
+
+  // The E-stop settles, but no edge comes on the wall-switch input: the countdown runs to its 10 s timeout
+  runFor(6600);
+  TEST_ASSERT_EQUAL_STRING("    Waiting :1s     ", sim_lcdRow(3));
+  takeTelemetry();
+  runFor(500);
+  assertScreen("E-STOP  OK  R3000ms ",
+               "WALL SW NOK no edge ",
+               " Push next button   ",
+               " if the test is OK  ");
+
+  // The verdicts follow the inputs until the operator moves on
+  sim_setPin(pin_Emergency, HIGH);
+  runFor(200);
+  TEST_ASSERT_EQUAL_STRING_LEN("E-STOP  NOK ", sim_lcdRow(0), 12);
+  sim_setPin(pin_Emergency, LOW);
+  runFor(200);
+  TEST_ASSERT_EQUAL_STRING_LEN("E-STOP  OK  ", sim_lcdRow(0), 12);
+
+  pressNextButton();
+  TEST_ASSERT_EQUAL(SEQUENCE_3, channels[0].sequence);
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Telemetry: the frames sent during sequences 1 and 2 are complete and carry valid CRCs
+//=====================================================================================================================================================
+static uint32_t read32(const uint8_t* data) {
+  return data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+void test_telemetry_frames() {
+  takeTelemetry();
+  DecodedFrame frames[16];
+  uint8_t count = decodeFrames(telemetryStream, telemetrySize, frames, 16);
+  TEST_ASSERT_EQUAL(0, telemetry_droppedFrames());
+
+  // Start of sequences 1 and 2, the five E-stop edges, the statistics and verdict of each sequence, then the start of
+  // sequence 3
+  TEST_ASSERT_EQUAL(12, count);
+  TEST_ASSERT_EQUAL(FRAME_SEQUENCE_START, frames[0].type);
+  TEST_ASSERT_EQUAL(0, frames[0].payload[0]);
+  TEST_ASSERT_EQUAL(FRAME_SEQUENCE_START, frames[1].type);
+  TEST_ASSERT_EQUAL(1, frames[1].payload[0]);
+  for (uint8_t i = 2; i <= 6; i++) {
+    TEST_ASSERT_EQUAL(FRAME_EDGE, frames[i].type);
+    TEST_ASSERT_EQUAL(EDGE_EMERGENCY, frames[i].payload[0]);
+  }
+  TEST_ASSERT_EQUAL(setupEnd + 3000000UL, read32(&frames[2].payload[2]));
+  TEST_ASSERT_EQUAL(FRAME_EDGE_STATS, frames[7].type);
+  TEST_ASSERT_EQUAL(5, frames[7].payload[2]);
+  TEST_ASSERT_EQUAL(FRAME_SEQUENCE_END, frames[8].type);
+  TEST_ASSERT_EQUAL(VERDICT_OK, frames[8].payload[1]);
+  TEST_ASSERT_UINT32_WITHIN(10, 3000, read32(&frames[8].payload[10]));
+  TEST_ASSERT_EQUAL(FRAME_EDGE_STATS, frames[9].type);
+  TEST_ASSERT_EQUAL(0, frames[9].payload[2]);
+  TEST_ASSERT_EQUAL(FRAME_SEQUENCE_END, frames[10].type);
+  TEST_ASSERT_EQUAL(1, frames[10].payload[0]);
+  TEST_ASSERT_EQUAL(VERDICT_NOK, frames[10].payload[1]);
+  TEST_ASSERT_EQUAL(SETTLE_NONE, read32(&frames[10].payload[10]));
+  TEST_ASSERT_EQUAL(FRAME_SEQUENCE_START, frames[11].type);
+  TEST_ASSERT_EQUAL(2, frames[11].payload[0]);
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Sequence 3: the START signal energizes the gantry
+//=====================================================================================================================================================
+void test_start_scanner() {
+  runFor(10100);
+  TEST_ASSERT_EQUAL_STRING("     IF FORCE:      ", sim_lcdRow(0));
+
+  sim_setPin(pin_Start, LOW);
+  runFor(200);
+  TEST_ASSERT_EQUAL_STRING("  GANTRY SHOULD BE  ", sim_lcdRow(0));
+  sim_setPin(pin_Start, HIGH);
+  pressNextButton();
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Sequence 4: the shutdown request arrives after the RED BUTTON prompt, its contact chatters once
+//=====================================================================================================================================================
+// Collects the trace frames sent after a 'T' command into a CAPTURE_BUFFER_SIZE buffer
+static void receiveTrace(uint8_t* trace) {
+  uint8_t stream[UART_TX_BUFFER_SIZE];
+  sim_uartTake(stream, sizeof(stream));
+  const uint8_t command = 'T';
+  sim_uartReceive(&command, 1);
+
+  uint16_t received = 0;
+  for (uint8_t attempt = 0; attempt < 50 && received < CAPTURE_BUFFER_SIZE; attempt++) {
+    runFor(5);
+    size_t size = sim_uartTake(stream, sizeof(stream));
+    for (size_t position = 0; position < size; position += stream[position + 2] + TELEMETRY_FRAME_OVERHEAD) {
+      TEST_ASSERT_EQUAL(FRAME_CAPTURE_TRACE, stream[position + 1]);
+      uint8_t length = stream[position + 2] - 1;
+      memcpy(&trace[stream[position + 3]], &stream[position + 4], length);
+      received += length;
+    }
+  }
+  TEST_ASSERT_EQUAL(CAPTURE_BUFFER_SIZE, received);
+}
+
+static uint8_t traceSample(const uint8_t* trace, uint16_t sample) {
+  return (trace[sample >> 3] >> (sample & 7)) & 1;
+}
+
+void test_shutdown_request() {
+  // The line is idle from the start, the countdown ends after the stability window
+  sim_setPin(pin_Shutdown_request, LOW);
+  runFor(1100);
+  TEST_ASSERT_EQUAL_STRING("Push the RED BUTTON ", sim_lcdRow(0));
+
+  // The contact bounces once when it closes, then opens for 300 us 20 ms later: the debounced level is reached,
+  // the capture sees the glitch and the result turns to NOK
+  sim_setPin(pin_Shutdown_request, HIGH);
+  sim_advanceMicros(2000);
+  sim_setPin(pin_Shutdown_request, LOW);
+  sim_advanceMicros(300);
+  sim_setPin(pin_Shutdown_request, HIGH);
+  runFor(20);
+  sim_setPin(pin_Shutdown_request, LOW);
+  sim_advanceMicros(300);
+  sim_setPin(pin_Shutdown_request, HIGH);
+  runFor(200);
+  assertScreen("SHUTDOWN REQUEST NOK",
+               "E5 G1 300-20000us   ",
+               "Contact glitches    ",
+               "=> Push next button ");
+
+  uint8_t trace[CAPTURE_BUFFER_SIZE];
+  receiveTrace(trace);
+  uint16_t trigger = waveCapture_triggerSample();
+  TEST_ASSERT_EQUAL(LOW, traceSample(trace, trigger - 1));
+  TEST_ASSERT_EQUAL(HIGH, traceSample(trace, trigger));
+  TEST_ASSERT_EQUAL(HIGH, traceSample(trace, trigger + 19));
+  TEST_ASSERT_EQUAL(LOW, traceSample(trace, trigger + 20));
+  TEST_ASSERT_EQUAL(LOW, traceSample(trace, trigger + 22));
+  TEST_ASSERT_EQUAL(HIGH, traceSample(trace, trigger + 23));
+  TEST_ASSERT_EQUAL(HIGH, traceSample(trace, trigger + 222));
+  TEST_ASSERT_EQUAL(LOW, traceSample(trace, trigger + 223));
+  TEST_ASSERT_EQUAL(LOW, traceSample(trace, trigger + 225));
+  TEST_ASSERT_EQUAL(HIGH, traceSample(trace, trigger + 226));
+  TEST_ASSERT_EQUAL(HIGH, traceSample(trace, CAPTURE_SAMPLES - 1));
+  pressNextButton();
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Sequence 5: the shutdown request is still held, the command is driven after the 20 s timeout and the machine
+// releases the request 35 ms later, then the box returns to sequence 1
+//=====================================================================================================================================================
+void test_shutdown_command() {
+  runFor(19000);
+  TEST_ASSERT_EQUAL(LOW, sim_pin(out_pin_Shutdown_command));
+  while (sim_pin(out_pin_Shutdown_command) == LOW) {
+    sim_advanceMicros(500);
+    loop();
+  }
+  runFor(35);
+  sim_setPin(pin_Shutdown_request, LOW);
+  runFor(1100);
+  TEST_ASSERT_EQUAL_STRING("  Did the system    ", sim_lcdRow(0));
+
+  pressNextButton();
+  TEST_ASSERT_EQUAL(LOW, sim_pin(out_pin_Shutdown_command));
+  TEST_ASSERT_EQUAL_STRING("SHUTDOWN COMMAND OK ", sim_lcdRow(0));
+
+  pressNextButton();
+  assertScreen("LATENCY min/avg/max ",
+               "35/35/35ms n1       ",
+               "Last: 35ms          ",
+               "Hist 00000010       ");
+
+  pressNextButton();
+  TEST_ASSERT_EQUAL_STRING("    FINAL TEST:     ", sim_lcdRow(0));
+  runFor(5100);
+  TEST_ASSERT_EQUAL_STRING("TURN OFF the casing ", sim_lcdRow(3));
+
+  pressNextButton();
+  runFor(100);
+  TEST_ASSERT_EQUAL_STRING("   EMERGENCY STOP   ", sim_lcdRow(1));
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Journal: the cycle is written to the EEPROM in the background, survives a restart and is dumped on request
+//=====================================================================================================================================================
+void test_journal() {
+  // 16 bytes at 3.4 ms each
+  runFor(100);
+  TEST_ASSERT_FALSE(journal_busy());
+  TEST_ASSERT_EQUAL(1, journal_count());
+
+  JournalRecord record;
+  TEST_ASSERT_TRUE(journal_read(JOURNAL_CAPACITY - 1, record));
+  TEST_ASSERT_EQUAL(0, record.run);
+  TEST_ASSERT_EQUAL(VERDICT_OK, journalRecord_verdict(record, 0));
+  TEST_ASSERT_EQUAL(VERDICT_NOK, journalRecord_verdict(record, 1));
+  TEST_ASSERT_EQUAL(VERDICT_OK, journalRecord_verdict(record, 2));
+  TEST_ASSERT_EQUAL(VERDICT_NOK, journalRecord_verdict(record, 3));
+  TEST_ASSERT_EQUAL(VERDICT_CONFIRMED, journalRecord_verdict(record, 4));
+  // The E-stop timing is the one of its last transition: pushed again 10.3 s after the prompt, without bounce
+  TEST_ASSERT_EQUAL(10300, record.emergencyResponse);
+  TEST_ASSERT_EQUAL(0, record.emergencySettle);
+  TEST_ASSERT_EQUAL(0, record.bounces & JOURNAL_BOUNCES_MAX);
+  TEST_ASSERT_EQUAL(JOURNAL_TIME_NONE, record.wallSwitchResponse);
+  TEST_ASSERT_EQUAL(350, record.roundTrip);
+
+  // A restart finds the record again and continues the run counter
+  journal_begin();
+  TEST_ASSERT_EQUAL(1, journal_count());
+  TEST_ASSERT_EQUAL(1, journal_nextRun());
+
+  // The dump sends the record, then the end frame with the number of records
+  uint8_t stream[256];
+  sim_uartTake(stream, sizeof(stream));
+  const uint8_t command = 'D';
+  sim_uartReceive(&command, 1);
+  runFor(20);
+  size_t size = sim_uartTake(stream, sizeof(stream));
+  TEST_ASSERT_EQUAL(2 * TELEMETRY_FRAME_OVERHEAD + JOURNAL_RECORD_SIZE + 1, size);
+  TEST_ASSERT_EQUAL(FRAME_JOURNAL_RECORD, stream[1]);
+  TEST_ASSERT_EQUAL(JOURNAL_RECORD_SIZE, stream[2]);
+  TEST_ASSERT_EQUAL_MEMORY(&record, &stream[3], JOURNAL_RECORD_SIZE);
+  TEST_ASSERT_EQUAL(FRAME_JOURNAL_END, stream[JOURNAL_RECORD_SIZE + 6]);
+  TEST_ASSERT_EQUAL(1, stream[JOURNAL_RECORD_SIZE + 8]);
+
+  // The journal stays busy until the last byte write ends: a read as soon as it is free finds the whole record, and
+  // the EEPROM interrupt is off again
+  JournalRecord appended;
+  journalRecord_clear(appended, journal_nextRun());
+  journalRecord_setVerdict(appended, 0, VERDICT_NOK);
+  TEST_ASSERT_TRUE(journal_append(appended));
+  uint8_t timers = sim_timerInterrupts();
+  while (journal_busy()) {
+    sim_advanceMicros(100);
+  }
+  TEST_ASSERT_EQUAL(timers - 1, sim_timerInterrupts());
+  TEST_ASSERT_TRUE(journal_read(JOURNAL_CAPACITY - 1, record));
+  TEST_ASSERT_EQUAL_MEMORY(&appended, &record, JOURNAL_RECORD_SIZE);
+
+  // A dump asked right after an append waits for it, then sends the new record too
+  appended.run = journal_nextRun();
+  TEST_ASSERT_TRUE(journal_append(appended));
+  sim_uartReceive(&command, 1);
+  runFor(100);
+  size = sim_uartTake(stream, sizeof(stream));
+  TEST_ASSERT_EQUAL(4 * TELEMETRY_FRAME_OVERHEAD + 3 * JOURNAL_RECORD_SIZE + 1, size);
+  TEST_ASSERT_EQUAL(FRAME_JOURNAL_RECORD, stream[2 * (JOURNAL_RECORD_SIZE + 5) + 1]);
+  TEST_ASSERT_EQUAL_MEMORY(&appended, &stream[2 * (JOURNAL_RECORD_SIZE + 5) + 3], JOURNAL_RECORD_SIZE);
+  TEST_ASSERT_EQUAL(3, stream[3 * (JOURNAL_RECORD_SIZE + 5) + 3]);
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Display: a screen that does not change sends nothing to the LCD
+//=====================================================================================================================================================
+void test_static_screen_sends_nothing() {
+  runFor(10100);
+  unsigned long bytes = sim_lcdBytes();
+  runFor(1000);
+  TEST_ASSERT_EQUAL(bytes, sim_lcdBytes());
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Debouncer: contact bounce is filtered out and a clean press is taken within a few milliseconds
+//=====================================================================================================================================================
+void test_button_debounce() {
+  TEST_ASSERT_EQUAL(SEQUENCE_1, channels[0].sequence);
+
+  // Bounces shorter than four 1 ms samples are not a press
+  for (uint8_t i = 0; i < 5; i++) {
+    sim_setPin(button_next_sequence, LOW);
+    runFor(2);
+    sim_setPin(button_next_sequence, HIGH);
+    runFor(1);
+  }
+  runFor(50);
+  TEST_ASSERT_EQUAL(SEQUENCE_1, channels[0].sequence);
+
+  sim_setPin(button_next_sequence, LOW);
+  runFor(15);
+  TEST_ASSERT_EQUAL(SEQUENCE_3, channels[0].sequence);
+  sim_setPin(button_next_sequence, HIGH);
+  runFor(15);
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// LCD: a screen change is queued and sent by the TWI interrupt as one transaction, loop() does not wait for the bus
+//=====================================================================================================================================================
+void test_display_sent_in_background() {
+  sim_enableBusTiming(true);
+  unsigned long lcdBytes = sim_lcdBytes();
+  unsigned long transactions = sim_i2cTransactions();
+  unsigned long i2cBytes = sim_i2cBytes();
+
+  // The countdown of sequence 3 changes its row every second
+  for (uint16_t i = 0; i < 2000 && sim_i2cTransactions() == transactions; i++) {
+    sim_advanceMicros(500);
+    unsigned long start = hal_micros();
+    loop();
+    TEST_ASSERT_EQUAL(start, hal_micros());
+  }
+  TEST_ASSERT_EQUAL(transactions + 1, sim_i2cTransactions());
+  TEST_ASSERT_FALSE(lcd_idle());
+  TEST_ASSERT_EQUAL(lcdBytes, sim_lcdBytes());
+
+  // Six PCF8574 writes per LCD byte, 90 us each
+  for (uint8_t i = 0; i < 100 && !lcd_idle(); i++) {
+    sim_advanceMicros(500);
+  }
+  TEST_ASSERT_TRUE(lcd_idle());
+  TEST_ASSERT_TRUE(sim_lcdBytes() > lcdBytes);
+  TEST_ASSERT_EQUAL(6 * (sim_lcdBytes() - lcdBytes), sim_i2cBytes() - i2cBytes);
+  TEST_ASSERT_EQUAL(transactions + 1, sim_i2cTransactions());
+  sim_enableBusTiming(false);
+}
+
+// A countdown change dropped by a bus error is rewritten once the backpack answers again, although it did not change
+void test_display_rewritten_after_bus_error() {
+  uint8_t errors = lcd_busErrors();
+  sim_i2cSetAcknowledge(false);
+  for (uint16_t i = 0; i < 2000 && lcd_busErrors() == errors; i++) {
+    runFor(1);
+  }
+  TEST_ASSERT_TRUE(lcd_busErrors() != errors);
+  unsigned long countdown = channels[0].countdownValue;
+
+  sim_i2cSetAcknowledge(true);
+  runFor(200);
+  TEST_ASSERT_EQUAL(countdown, channels[0].countdownValue);
+  char expected[8];
+  snprintf(expected, sizeof(expected), "%lus ", countdown);
+  bool shown = false;
+  for (uint8_t row = 0; row < LCD_ROWS; row++) {
+    shown = shown || strstr(sim_lcdRow(row), expected) != nullptr;
+  }
+  TEST_ASSERT_TRUE(shown);
+}
+//=====================================================================================================================================================
+
+
+
+
+//=====================================================================================================================================================
+// Remote control: the line PC starts, confirms and skips sequences over the serial line, each command is answered
+//=====================================================================================================================================================
+static uint8_t runCommand(const char* command, DecodedFrame* frames, uint8_t maxFrames) {
+  uint8_t stream[128];
+  sim_uartTake(stream, sizeof(stream));
+  sendCommand(command);
+  runFor(10);
+  return decodeFrames(stream, sim_uartTake(stream, sizeof(stream)), frames, maxFrames);
+}
+
+void test_remote_control() {
+  DecodedFrame frames[8];
+  TEST_ASSERT_EQUAL(SEQUENCE_3, channels[0].sequence);
+
+  // A start command without a valid sequence number is refused
+  TEST_ASSERT_EQUAL(1, runCommand("S9", frames, 8));
+  TEST_ASSERT_EQUAL(FRAME_COMMAND_ACK, frames[0].type);
+  TEST_ASSERT_EQUAL('S', frames[0].payload[0]);
+  TEST_ASSERT_EQUAL(0, frames[0].payload[1]);
+  TEST_ASSERT_EQUAL(SEQUENCE_3, channels[0].sequence);
+
+  // The start command and its number can arrive in separate reads
+  TEST_ASSERT_EQUAL(0, runCommand("S", frames, 8));
+  TEST_ASSERT_EQUAL(3, runCommand("5", frames, 8));
+  TEST_ASSERT_EQUAL(FRAME_SEQUENCE_END, frames[0].type);
+  TEST_ASSERT_EQUAL(SEQUENCE_3, frames[0].payload[0]);
+  TEST_ASSERT_EQUAL(VERDICT_SKIPPED, frames[0].payload[1]);
+  TEST_ASSERT_EQUAL(FRAME_SEQUENCE_START, frames[1].type);
+  TEST_ASSERT_EQUAL(SEQUENCE_5, frames[1].payload[0]);
+  TEST_ASSERT_EQUAL(FRAME_COMMAND_ACK, frames[2].type);
+  TEST_ASSERT_EQUAL(1, frames[2].payload[1]);
+  TEST_ASSERT_EQUAL(SEQUENCE_5, frames[2].payload[2]);
+  TEST_ASSERT_EQUAL(SEQUENCE_5, channels[0].sequence);
+
+  // The countdown takes no confirmation
+  TEST_ASSERT_EQUAL(1, runCommand("N", frames, 8));
+  TEST_ASSERT_EQUAL(0, frames[0].payload[1]);
+
+  // The status reports the shutdown command driven by the question step
+  runFor(20100);
+  TEST_ASSERT_EQUAL(1, runCommand("P", frames, 8));
+  TEST_ASSERT_EQUAL(FRAME_STATUS, frames[0].type);
+  TEST_ASSERT_EQUAL(SEQUENCE_5, frames[0].payload[0]);
+  TEST_ASSERT_EQUAL(1, frames[0].payload[1]);
+  TEST_ASSERT_EQUAL(1 << button_next_sequence, frames[0].payload[3] & (1 << button_next_sequence));
+  TEST_ASSERT_EQUAL(HIGH, frames[0].payload[4]);
+
+  // A confirmation answers the question like the next button: yes, the machine went off
+  TEST_ASSERT_EQUAL(1, runCommand("N", frames, 8));
+  TEST_ASSERT_EQUAL(1, frames[0].payload[1]);
+  TEST_ASSERT_EQUAL(1, runCommand("P", frames, 8));
+  TEST_ASSERT_EQUAL(2, frames[0].payload[1]);
+  TEST_ASSERT_EQUAL(LOW, frames[0].payload[4]);
+
+  // The results of the running cycle show the skipped sequence 3
+  TEST_ASSERT_EQUAL(1, runCommand("R", frames, 8));
+  TEST_ASSERT_EQUAL(FRAME_CYCLE_RECORD, frames[0].type);
+  JournalRecord record;
+  memcpy(&record, frames[0].payload, JOURNAL_RECORD_SIZE);
+  TEST_ASSERT_EQUAL(VERDICT_SKIPPED, journalRecord_verdict(record, SEQUENCE_3));
+
+  // Skipping the end of sequence 5 still journals the cycle and goes back to sequence 1
+  uint8_t records = journal_count();
+  runCommand("K", frames, 8);
+  TEST_ASSERT_EQUAL(SEQUENCE_1, channels[0].sequence);
+  TEST_ASSERT_EQUAL(LOW, sim_pin(out_pin_Shutdown_command));
+  runFor(100);
+  TEST_ASSERT_EQUAL(records + 1, journal_count());
+  TEST_ASSERT_TRUE(journal_read(JOURNAL_CAPACITY - 1, record));
+  TEST_ASSERT_EQUAL(VERDICT_SKIPPED, journalRecord_verdict(record, SEQUENCE_3));
+  TEST_ASSERT_EQUAL(VERDICT_SKIPPED, journalRecord_verdict(record, SEQUENCE_5));
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Idle sleep: between the passes the CPU sleeps, woken at least every millisecond by the debouncer timer
+//=====================================================================================================================================================
+void test_idle_sleep() {
+  DecodedFrame frames[8];
+
+  // The first report closes the window of the previous tests
+  TEST_ASSERT_EQUAL(1, runCommand("W", frames, 8));
+  TEST_ASSERT_EQUAL(FRAME_POWER_STATS, frames[0].type);
+
+  // Waiting for the E-stop, the box sleeps nearly all the time: the simulated tasks take no time, the CPU is only
+  // awake from the interrupt that makes a task due to the next call of loop()
+  runFor(1000);
+  TEST_ASSERT_EQUAL(1, runCommand("W", frames, 8));
+  TEST_ASSERT_EQUAL(FRAME_POWER_STATS, frames[0].type);
+  unsigned long window = read32(&frames[0].payload[0]);
+  unsigned long asleep = read32(&frames[0].payload[4]);
+  unsigned long wakeups = read32(&frames[0].payload[8]);
+  uint16_t longestSleep = frames[0].payload[12] | (frames[0].payload[13] << 8);
+  TEST_ASSERT_UINT32_WITHIN(1, 1010, window);
+  TEST_ASSERT_TRUE(asleep <= window);
+  TEST_ASSERT_TRUE(asleep >= window * 9 / 10);
+  TEST_ASSERT_TRUE(wakeups >= 1000);
+  TEST_ASSERT_TRUE(longestSleep > 0);
+  TEST_ASSERT_TRUE(longestSleep <= DEBOUNCER_SAMPLE_PERIOD_US);
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Contact bounce: a request contact that bounces when it closes, then holds, passes sequence 4
+//=====================================================================================================================================================
+void test_bouncing_request_passes() {
+  DecodedFrame frames[8];
+  sim_setPin(pin_Shutdown_request, LOW);
+  runCommand("S4", frames, 8);
+  TEST_ASSERT_EQUAL(SEQUENCE_4, channels[0].sequence);
+  runFor(1100);
+  TEST_ASSERT_EQUAL_STRING("Push the RED BUTTON ", sim_lcdRow(0));
+
+  // Three bounces in the first 3 ms, shorter than the debouncer window
+  sim_setPin(pin_Shutdown_request, HIGH);
+  sim_advanceMicros(1000);
+  sim_setPin(pin_Shutdown_request, LOW);
+  sim_advanceMicros(500);
+  sim_setPin(pin_Shutdown_request, HIGH);
+  sim_advanceMicros(1000);
+  sim_setPin(pin_Shutdown_request, LOW);
+  sim_advanceMicros(500);
+  sim_setPin(pin_Shutdown_request, HIGH);
+  runFor(200);
+  assertScreen("SHUTDOWN REQUEST OK ",
+               "E5 G0 500-1000us    ",
+               "Shutdown request OK ",
+               "=> Push next button ");
+
+  // The sequence ends on the next run of the sequence task after the confirmation
+  uint8_t stream[128];
+  sim_uartTake(stream, sizeof(stream));
+  sendCommand("N");
+  runFor(30);
+  uint8_t count = decodeFrames(stream, sim_uartTake(stream, sizeof(stream)), frames, 8);
+  TEST_ASSERT_TRUE(count >= 2);
+  TEST_ASSERT_EQUAL(FRAME_COMMAND_ACK, frames[0].type);
+  TEST_ASSERT_EQUAL(1, frames[0].payload[1]);
+  TEST_ASSERT_EQUAL(FRAME_SEQUENCE_END, frames[1].type);
+  TEST_ASSERT_EQUAL(SEQUENCE_4, frames[1].payload[0]);
+  TEST_ASSERT_EQUAL(VERDICT_OK, frames[1].payload[1]);
+}
+//=====================================================================================================================================================
+
+
+
+int main() {
+  sim_reset();
+  setup();
+  setupEnd = hal_micros();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_passive_checks);
+  RUN_TEST(test_telemetry_frames);
+  RUN_TEST(test_start_scanner);
+  RUN_TEST(test_shutdown_request);
+  RUN_TEST(test_shutdown_command);
+  RUN_TEST(test_journal);
+  RUN_TEST(test_static_screen_sends_nothing);
+  RUN_TEST(test_button_debounce);
+  RUN_TEST(test_display_sent_in_background);
+  RUN_TEST(test_display_rewritten_after_bus_error);
+  RUN_TEST(test_remote_control);
+  RUN_TEST(test_idle_sleep);
+  RUN_TEST(test_bouncing_request_passes);
+  return UNITY_END();
+}
@@ -0,0 +1,217 @@
+//=====================================================================================================================================================
+// Native benchmark: loop latency, LCD / I2C traffic and duration of each sequence under a scripted operator session
+//=====================================================================================================================================================
+// The CPU time of every loop() call is measured on the host clock, in ns. It is compared with the time the host takes
+// to run a reference piece of the firmware, the CRC of 255 bytes, so the budgets follow the speed of the host and of
+// the build flags. That loop() never waits for the simulated I2C bus is checked by test_native_replay.
+// The LCD traffic is charged to the sequence it was sent in; when sequences run together, every call is charged to
+// each of them. One JSON object per sequence is printed, plus one for the whole session:
+//   pio test -e native -f test_native_benchmark -v
+// The budgets at the end make the test fail when a change makes the firmware slower. The CPU time on the box itself
+// is reported by the remote command W, as the time spent awake.
+//=====================================================================================================================================================
+#include <unity.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "Hal.h"
+#include "Channel.h"
+#include "Pins.h"
+#include "SequenceTable.h"
+#include "Telemetry.h"
+
+void setup();
+void loop();
+extern Channel channels[CHANNEL_COUNT];
+
+const unsigned long IDLE_BETWEEN_LOOPS_US = 100;  // Time between two loop() calls spent outside the firmware
+const uint8_t REFERENCE_BYTES = 255;              // Length of the reference CRC
+const unsigned long CPU_P99_BUDGET_PERCENT = 15;  // 99th percentile of loop() CPU time allowed, in % of the reference
+const unsigned long CPU_P999_BUDGET_PERCENT = 100; // 99.9th percentile: the passes that refresh the display
+const unsigned long CYCLE_BUDGET_MS = 90000;      // Duration allowed for the five sequences
+
+
+
+//=====================================================================================================================================================
+// Measurements
+//=====================================================================================================================================================
+struct SequenceMeasure {
+  std::vector<unsigned long> cpuTimes;            // Host CPU time of every loop() call, in ns
+  unsigned long wallTime;                         // Virtual time spent in the sequence, in us
+  unsigned long lcdBytes;
+  unsigned long i2cTransactions;
+};
+
+static SequenceMeasure measures[SEQUENCE_COUNT];
+static SequenceMeasure session;                   // The whole session, each call counted once
+
+static unsigned long elapsedNanoseconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void charge(SequenceMeasure& measure, unsigned long wallTime, unsigned long cpu, unsigned long bytes,
+                   unsigned long transactions) {
+  measure.cpuTimes.push_back(cpu);
+  measure.wallTime += wallTime;
+  measure.lcdBytes += bytes;
+  measure.i2cTransactions += transactions;
+}
+
+// Runs loop() for the given virtual time and charges every call to the sequences running when it started
+static void runFor(unsigned long milliseconds) {
+  unsigned long end = hal_micros() + milliseconds * 1000UL;
+  while (hal_micros() < end) {
+    const Channel& channel = channels[0];
+    uint8_t sequences[LANE_MAX];
+    uint8_t laneCount = channel.laneCount;
+    for (uint8_t lane = 0; lane < laneCount; lane++) {
+      sequences[lane] = channel.lanes[lane].sequence;
+    }
+    unsigned long bytes = sim_lcdBytes();
+    unsigned long transactions = sim_i2cTransactions();
+    unsigned long start = hal_micros();
+    sim_advanceMicros(IDLE_BETWEEN_LOOPS_US);
+
+    std::chrono::steady_clock::time_point cpuStart = std::chrono::steady_clock::now();
+    loop();
+    unsigned long cpu = elapsedNanoseconds(cpuStart);
+    unsigned long wallTime = hal_micros() - start;
+
+    bytes = sim_lcdBytes() - bytes;
+    transactions = sim_i2cTransactions() - transactions;
+    for (uint8_t lane = 0; lane < laneCount; lane++) {
+      charge(measures[sequences[lane]], wallTime, cpu, bytes, transactions);
+    }
+    charge(session, wallTime, cpu, bytes, transactions);
+  }
+}
+
+// Median host time of the reference, in ns
+static unsigned long measureReference() {
+  uint8_t data[REFERENCE_BYTES];
+  for (uint8_t index = 0; index < REFERENCE_BYTES; index++) {
+    data[index] = index * 37;
+  }
+  std::vector<unsigned long> times;
+  volatile uint16_t crc = 0;
+  for (unsigned int run = 0; run < 1001; run++) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    crc = crc + telemetry_crc16(0xFFFF, data, REFERENCE_BYTES);
+    times.push_back(elapsedNanoseconds(start));
+  }
+  std::sort(times.begin(), times.end());
+  return times[times.size() / 2];
+}
+
+static void pressNextButton() {
+  sim_setPin(button_next_sequence, LOW);
+  runFor(100);
+  sim_setPin(button_next_sequence, HIGH);
+  runFor(100);
+}
+
+// Percentile in tenths of a percent, 999 for the 99.9th
+static unsigned long percentile(std::vector<unsigned long> values, unsigned int permille) {
+  if (values.empty()) {
+    return 0;
+  }
+  std::sort(values.begin(), values.end());
+  return values[(values.size() - 1) * permille / 1000];
+}
+
+static unsigned long maximum(const std::vector<unsigned long>& values) {
+  return values.empty() ? 0 : *std::max_element(values.begin(), values.end());
+}
+
+static unsigned long perSecond(unsigned long count, unsigned long micros) {
+  return micros == 0 ? 0 : (unsigned long)((unsigned long long)count * 1000000ULL / micros);
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Scripted operator session: every check passes, the operator reacts 500 ms after each prompt
+//=====================================================================================================================================================
+static void runSession() {
+  // Sequences 1 and 2 run together: the inputs are already at their expected level, the shared countdown ends after
+  // the stability window and one confirmation ends both
+  sim_setPin(pin_Emergency, LOW);
+  sim_setPin(pin_Wall_switch, LOW);
+  runFor(1500);
+  pressNextButton();
+
+  // Sequence 3: the START signal arrives after the countdown
+  runFor(10500);
+  sim_setPin(pin_Start, LOW);
+  runFor(500);
+  sim_setPin(pin_Start, HIGH);
+  pressNextButton();
+
+  // Sequence 4: the shutdown request arrives after the countdown
+  sim_setPin(pin_Shutdown_request, LOW);
+  runFor(1500);
+  sim_setPin(pin_Shutdown_request, HIGH);
+  runFor(500);
+  pressNextButton();
+
+  // Sequence 5: the RED BUTTON is released, the machine answers the shutdown command on START about 500 ms later,
+  // then the four confirmations and the final test message
+  sim_setPin(pin_Shutdown_request, LOW);
+  runFor(1500);
+  sim_setPin(pin_Start, LOW);
+  runFor(500);
+  pressNextButton();
+  sim_setPin(pin_Start, HIGH);
+  runFor(500);
+  pressNextButton();
+  runFor(500);
+  pressNextButton();
+  runFor(5500);
+  pressNextButton();
+}
+//=====================================================================================================================================================
+
+
+
+void test_benchmark_session() {
+  unsigned long reference = measureReference();
+  runSession();
+
+  for (uint8_t sequence = 0; sequence < SEQUENCE_COUNT; sequence++) {
+    const SequenceMeasure& measure = measures[sequence];
+    printf("{\"benchmark\":\"sequence\",\"sequence\":%u,\"iterations\":%lu,\"cpu_p99_ns\":%lu,"
+           "\"cpu_p999_ns\":%lu,\"cpu_max_ns\":%lu,\"lcd_bytes_per_s\":%lu,\"i2c_transactions_per_s\":%lu,"
+           "\"wall_time_ms\":%lu}\n",
+           sequence + 1, (unsigned long)measure.cpuTimes.size(), percentile(measure.cpuTimes, 990),
+           percentile(measure.cpuTimes, 999), maximum(measure.cpuTimes),
+           perSecond(measure.lcdBytes, measure.wallTime), perSecond(measure.i2cTransactions, measure.wallTime),
+           measure.wallTime / 1000);
+  }
+
+  unsigned long cpuP99 = percentile(session.cpuTimes, 990);
+  unsigned long cpuP999 = percentile(session.cpuTimes, 999);
+  printf("{\"benchmark\":\"cycle\",\"iterations\":%lu,\"cpu_p99_ns\":%lu,\"cpu_p999_ns\":%lu,"
+         "\"cpu_max_ns\":%lu,\"reference_ns\":%lu,\"lcd_bytes\":%lu,\"i2c_transactions\":%lu,"
+         "\"i2c_bytes\":%lu,\"wall_time_ms\":%lu}\n",
+         (unsigned long)session.cpuTimes.size(), cpuP99, cpuP999, maximum(session.cpuTimes),
+         reference, sim_lcdBytes(), sim_i2cTransactions(), sim_i2cBytes(), session.wallTime / 1000);
+
+  // The maximum is left out: the host scheduler can preempt any call
+  TEST_ASSERT_LESS_OR_EQUAL(reference * CPU_P99_BUDGET_PERCENT / 100, cpuP99);
+  TEST_ASSERT_LESS_OR_EQUAL(reference * CPU_P999_BUDGET_PERCENT / 100, cpuP999);
+  TEST_ASSERT_LESS_OR_EQUAL(CYCLE_BUDGET_MS, session.wallTime / 1000);
+}
+
+
+
+int main() {
+  sim_reset();
+  setup();
+  sim_enableBusTiming(true);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_benchmark_session);
+  return UNITY_END();
+}
@@ -0,0 +1,193 @@
+//=====================================================================================================================================================
+// Native tests: three machines tested at once, channel 0 on the Uno pins and channels 1 and 2 on the I/O expander
+//=====================================================================================================================================================
+// Built with -DCHANNEL_COUNT=3 by its own environment: pio test -e native_channels
+// The tests follow one session and must run in this order, the machines are driven independently of each other.
+//=====================================================================================================================================================
+#include <unity.h>
+#include "Hal.h"
+#include "Channel.h"
+#include "IoExpander.h"
+#include "Journal.h"
+#include "LcdI2c.h"
+#include "Pins.h"
+#include "SequenceTable.h"
+#include "Telemetry.h"
+#include "Uart.h"
+
+void setup();
+void loop();
+extern Channel channels[CHANNEL_COUNT];
+
+
+
+//=====================================================================================================================================================
+// Helpers
+//=====================================================================================================================================================
+// Runs loop() while the virtual clock advances in 500 us steps
+static void runFor(unsigned long milliseconds) {
+  for (unsigned long i = 0; i < milliseconds * 2; i++) {
+    sim_advanceMicros(500);
+    loop();
+  }
+}
+
+// Presses and releases the next button, each level held long enough for the debouncer
+static void pressNextButton() {
+  sim_setPin(button_next_sequence, LOW);
+  runFor(100);
+  sim_setPin(button_next_sequence, HIGH);
+  runFor(100);
+}
+
+struct DecodedFrame {
+  uint8_t type;
+  uint8_t length;
+  uint8_t payload[TELEMETRY_MAX_PAYLOAD];
+};
+
+// Splits a telemetry stream into its frames, checking the sync byte and the CRC of each
+static uint8_t decodeFrames(const uint8_t* stream, size_t size, DecodedFrame* frames, uint8_t maxFrames) {
+  uint8_t count = 0;
+  size_t position = 0;
+  while (position < size && count < maxFrames) {
+    TEST_ASSERT_EQUAL(TELEMETRY_SYNC, stream[position]);
+    DecodedFrame& frame = frames[count++];
+    frame.type = stream[position + 1];
+    frame.length = stream[position + 2];
+    memcpy(frame.payload, &stream[position + 3], frame.length);
+    uint16_t crc = stream[position + 3 + frame.length] | (stream[position + 4 + frame.length] << 8);
+    TEST_ASSERT_EQUAL(telemetry_crc16(0xFFFF, &stream[position + 1], frame.length + 2), crc);
+    position += frame.length + 5;
+  }
+  TEST_ASSERT_EQUAL(size, position);
+  return count;
+}
+
+// Sends a remote-control command and returns the frames sent while it is handled
+static uint8_t runCommand(const char* command, DecodedFrame* frames, uint8_t maxFrames) {
+  uint8_t stream[128];
+  sim_uartTake(stream, sizeof(stream));
+  sim_uartReceive((const uint8_t*)command, strlen(command));
+  runFor(10);
+  return decodeFrames(stream, sim_uartTake(stream, sizeof(stream)), frames, maxFrames);
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Every machine starts its own cycle, the LCD shows the number of the one it is about
+//=====================================================================================================================================================
+void test_every_channel_starts() {
+  for (uint8_t index = 0; index < CHANNEL_COUNT; index++) {
+    TEST_ASSERT_EQUAL(index, channels[index].index);
+    TEST_ASSERT_EQUAL(SEQUENCE_1, channels[index].sequence);
+  }
+  runFor(200);
+  TEST_ASSERT_EQUAL('1', sim_lcdRow(0)[LCD_COLUMNS - 1]);
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// A machine on the expander runs sequence 4 alone: the operator is called to it while machine 1 counts down
+//=====================================================================================================================================================
+void test_expander_channel_runs_alone() {
+  DecodedFrame frames[8];
+
+  // The remote commands act on the selected machine, the answers carry its channel above the sequence
+  TEST_ASSERT_EQUAL(1, runCommand("C2", frames, 8));
+  TEST_ASSERT_EQUAL(FRAME_COMMAND_ACK, frames[0].type);
+  TEST_ASSERT_EQUAL(1, frames[0].payload[1]);
+  TEST_ASSERT_EQUAL(telemetry_sequenceField(1, SEQUENCE_1), frames[0].payload[2]);
+  TEST_ASSERT_EQUAL(1, runCommand("C9", frames, 8));
+  TEST_ASSERT_EQUAL(0, frames[0].payload[1]);
+
+  runCommand("S4", frames, 8);
+  TEST_ASSERT_EQUAL(SEQUENCE_4, channels[1].sequence);
+  TEST_ASSERT_EQUAL(SEQUENCE_1, channels[0].sequence);
+  TEST_ASSERT_EQUAL(SEQUENCE_1, channels[2].sequence);
+
+  // Its shutdown request settles on the expander, the next step waits for the operator: the LCD moves to machine 2
+  sim_expanderSetInput(0, EXPANDER_SHUTDOWN_REQUEST, LOW);
+  runFor(1300);
+  TEST_ASSERT_EQUAL_STRING("Push the RED BUTTON2", sim_lcdRow(0));
+
+  // The request is released, the press confirms machine 2 only
+  sim_expanderSetInput(0, EXPANDER_SHUTDOWN_REQUEST, HIGH);
+  runFor(100);
+  uint8_t stream[128];
+  sim_uartTake(stream, sizeof(stream));
+  pressNextButton();
+  TEST_ASSERT_EQUAL(SEQUENCE_5, channels[1].sequence);
+  TEST_ASSERT_EQUAL(SEQUENCE_1, channels[0].sequence);
+  uint8_t count = decodeFrames(stream, sim_uartTake(stream, sizeof(stream)), frames, 8);
+  TEST_ASSERT_EQUAL(2, count);
+  TEST_ASSERT_EQUAL(FRAME_SEQUENCE_END, frames[0].type);
+  TEST_ASSERT_EQUAL(telemetry_sequenceField(1, SEQUENCE_4), frames[0].payload[0]);
+  TEST_ASSERT_EQUAL(VERDICT_OK, frames[0].payload[1]);
+  TEST_ASSERT_EQUAL(FRAME_SEQUENCE_START, frames[1].type);
+  TEST_ASSERT_EQUAL(telemetry_sequenceField(1, SEQUENCE_5), frames[1].payload[0]);
+
+  // Sequence 5 drives the shutdown command of machine 2 through the 74HC595, the Uno output stays LOW
+  sim_expanderSetInput(0, EXPANDER_SHUTDOWN_REQUEST, LOW);
+  runFor(1100);
+  TEST_ASSERT_EQUAL(1, channels[1].stepIndex);
+  TEST_ASSERT_EQUAL(HIGH, sim_expanderOutput(0, EXPANDER_SHUTDOWN_COMMAND));
+  TEST_ASSERT_EQUAL(LOW, sim_expanderOutput(1, EXPANDER_SHUTDOWN_COMMAND));
+  TEST_ASSERT_EQUAL(LOW, sim_pin(out_pin_Shutdown_command));
+  TEST_ASSERT_EQUAL(1, runCommand("P", frames, 8));
+  TEST_ASSERT_EQUAL(telemetry_sequenceField(1, SEQUENCE_5), frames[0].payload[0]);
+  TEST_ASSERT_EQUAL(HIGH, frames[0].payload[4]);
+  TEST_ASSERT_EQUAL(0, frames[0].payload[3] & (1 << pin_Shutdown_request));
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Two machines end their cycle together: both records are journaled, one after the other, with their channel
+//=====================================================================================================================================================
+void test_cycles_journaled_per_channel() {
+  DecodedFrame frames[32];
+  uint8_t records = journal_count();
+
+  // Machine 2 leaves sequence 5, machine 3 skips its four groups: both records are queued in the same task run
+  runCommand("KC3KKKK", frames, 32);
+  TEST_ASSERT_EQUAL(LOW, sim_expanderOutput(0, EXPANDER_SHUTDOWN_COMMAND));
+  TEST_ASSERT_EQUAL(SEQUENCE_1, channels[1].sequence);
+  TEST_ASSERT_EQUAL(SEQUENCE_1, channels[2].sequence);
+  runFor(200);
+  TEST_ASSERT_EQUAL(records + 2, journal_count());
+
+  JournalRecord first;
+  JournalRecord second;
+  TEST_ASSERT_TRUE(journal_read(JOURNAL_CAPACITY - 2, first));
+  TEST_ASSERT_TRUE(journal_read(JOURNAL_CAPACITY - 1, second));
+  TEST_ASSERT_EQUAL(1, first.bounces >> JOURNAL_CHANNEL_SHIFT);
+  TEST_ASSERT_EQUAL(2, second.bounces >> JOURNAL_CHANNEL_SHIFT);
+  TEST_ASSERT_EQUAL(first.run + 1, second.run);
+  TEST_ASSERT_EQUAL(VERDICT_OK, journalRecord_verdict(first, SEQUENCE_4));
+  TEST_ASSERT_EQUAL(VERDICT_SKIPPED, journalRecord_verdict(first, SEQUENCE_5));
+  TEST_ASSERT_EQUAL(VERDICT_SKIPPED, journalRecord_verdict(second, SEQUENCE_1));
+  TEST_ASSERT_EQUAL(VERDICT_SKIPPED, journalRecord_verdict(second, SEQUENCE_5));
+
+  // Machine 1 went on with its own cycle meanwhile
+  TEST_ASSERT_EQUAL(SEQUENCE_1, channels[0].sequence);
+}
+//=====================================================================================================================================================
+
+
+
+int main() {
+  sim_reset();
+  setup();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_every_channel_starts);
+  RUN_TEST(test_expander_channel_runs_alone);
+  RUN_TEST(test_cycles_journaled_per_channel);
+  return UNITY_END();
+}
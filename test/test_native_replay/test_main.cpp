@@ -0,0 +1,310 @@
+//=====================================================================================================================================================
+// Native replay: input traces recorded on a box are played back into the firmware under the virtual clock
+//=====================================================================================================================================================
+// A trace is recorded with tools/telemetry_decode.py --record-inputs, which restarts the box at sequence 1 with the
+// 'I' command. The replay sends the same command, then sets every recorded pin at its recorded time since the start,
+// so the firmware goes through the same session as the box did. It checks the verdicts, end times and durations the
+// box reported, the LCD rows added by hand as TRACE_SCREEN checkpoints, and that the recorder sends back the same
+// transitions. The replay is deterministic: a field trace that failed on a machine fails here on every run. One JSON
+// object per trace reports the longest time loop() was blocked on the I2C bus, which must stay 0: the TWI interrupt
+// sends the display in the background. The CPU time of loop() is measured by test_native_benchmark.
+//   pio test -e native -f test_native_replay -v
+//=====================================================================================================================================================
+#include <unity.h>
+#include <stdio.h>
+#include "Hal.h"
+#include "InputTrace.h"
+#include "Pins.h"
+#include "SequenceTable.h"
+#include "Telemetry.h"
+#include "Uart.h"
+
+void setup();
+void loop();
+
+const unsigned long LOOP_PERIOD_US = 500;         // loop() is called at least this often during a replay
+const unsigned long END_TOLERANCE_MS = 20;        // Two periods of the sequence task: the loop timing of a box differs
+const uint8_t MAX_SEQUENCE_ENDS = 32;
+const uint16_t MAX_TRANSITIONS = 256;
+const size_t WIRE_BYTES_PER_LOOP = UART_BAUD_RATE / 10 * LOOP_PERIOD_US / 1000000UL;   // 10 bits per byte
+
+
+
+//=====================================================================================================================================================
+// Trace format: the lines written by telemetry_decode.py, one macro each, included inside an array of TraceEvent
+//=====================================================================================================================================================
+enum TraceKind {
+  TRACE_KIND_LEVELS,                              // Levels of the recorded pins at the start, bit n = pin Dn
+  TRACE_KIND_PIN,                                 // A recorded pin changes
+  TRACE_KIND_SEQUENCE_END,                        // The box ended a sequence with this verdict
+  TRACE_KIND_SCREEN                               // Checkpoint written by hand: an LCD row at that time
+};
+
+struct TraceEvent {
+  uint8_t kind;                                   // TraceKind
+  unsigned long time;                             // Time since the start of the trace, in us
+  uint8_t index;                                  // Pin, sequence or LCD row
+  uint8_t value;                                  // Level, levels or verdict
+  unsigned long duration;                         // Duration of the sequence, in ms
+  const char* text;                               // Expected LCD row
+};
+
+#define TRACE_LEVELS(levels) { TRACE_KIND_LEVELS, 0, 0, levels, 0, nullptr },
+#define TRACE_PIN(us, pin, level) { TRACE_KIND_PIN, us, pin, level, 0, nullptr },
+#define TRACE_SEQUENCE_END(ms, sequence, verdict, duration) \
+  { TRACE_KIND_SEQUENCE_END, (ms) * 1000UL, sequence, verdict, duration, nullptr },
+#define TRACE_SCREEN(ms, row, text) { TRACE_KIND_SCREEN, (ms) * 1000UL, row, 0, 0, text },
+
+static const TraceEvent DESK_SESSION[] = {
+#include "traces/desk_session.trace"
+};
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// What the firmware reports during a replay
+//=====================================================================================================================================================
+struct SequenceEnd {
+  uint8_t sequence;
+  uint8_t verdict;
+  unsigned long time;                             // Since the start of the trace, in ms
+  unsigned long duration;                         // In ms
+};
+
+struct ReplayReport {
+  unsigned long start;                            // micros() when the firmware started recording
+  SequenceEnd ends[MAX_SEQUENCE_ENDS];
+  uint8_t endCount;
+  unsigned long transitions[MAX_TRANSITIONS];     // Times of the transitions recorded again by the firmware, in us
+  uint16_t transitionCount;
+  bool finished;                                  // The end frame of the recording arrived
+  unsigned long loops;
+  unsigned long blockedMax;                        // Longest loop() call on the virtual clock, in us
+  size_t wireBytes;                               // Bytes the serial line takes from the UART after each loop()
+};
+
+static ReplayReport report;
+
+static uint32_t read32(const uint8_t* data) {
+  return data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+// Decodes the telemetry sent so far, at most the given number of bytes: a frame cut by the limit waits in
+// pending for its end
+static uint8_t pending[UART_TX_BUFFER_SIZE];
+static size_t pendingSize = 0;
+
+static void collectTelemetry(size_t limit) {
+  size_t room = sizeof(pending) - pendingSize;
+  pendingSize += sim_uartTake(&pending[pendingSize], limit < room ? limit : room);
+  size_t position = 0;
+  while (position + 3 <= pendingSize && position + pending[position + 2] + TELEMETRY_FRAME_OVERHEAD <= pendingSize) {
+    TEST_ASSERT_EQUAL(TELEMETRY_SYNC, pending[position]);
+    const uint8_t* payload = &pending[position + 3];
+    switch (pending[position + 1]) {
+      case FRAME_SEQUENCE_END:
+        // The sequences skipped by the restart ended before the trace
+        if (payload[1] != VERDICT_SKIPPED && report.endCount < MAX_SEQUENCE_ENDS) {
+          SequenceEnd& end = report.ends[report.endCount++];
+          end.sequence = payload[0];
+          end.verdict = payload[1];
+          end.time = (read32(&payload[2]) * 1000UL - report.start) / 1000UL;
+          end.duration = read32(&payload[6]);
+        }
+        break;
+      case FRAME_INPUT_TRANSITION:
+        if (report.transitionCount < MAX_TRANSITIONS) {
+          report.transitions[report.transitionCount++] = read32(payload);
+        }
+        break;
+      case FRAME_INPUT_TRACE_END:
+        report.finished = true;
+        break;
+    }
+    position += pending[position + 2] + TELEMETRY_FRAME_OVERHEAD;
+  }
+  pendingSize -= position;
+  memmove(pending, &pending[position], pendingSize);
+}
+
+static void runLoop() {
+  unsigned long start = hal_micros();
+  loop();
+  unsigned long duration = hal_micros() - start;
+  if (duration > report.blockedMax) {
+    report.blockedMax = duration;
+  }
+  report.loops++;
+  collectTelemetry(report.wireBytes);
+}
+
+// Runs loop() until the given time since the start of the trace
+static void runUntil(unsigned long time) {
+  while (hal_micros() - report.start < time) {
+    unsigned long remaining = time - (hal_micros() - report.start);
+    sim_advanceMicros(remaining < LOOP_PERIOD_US ? remaining : LOOP_PERIOD_US);
+    runLoop();
+  }
+}
+
+// Sends a command and runs loop() until the serial task has taken it
+static void sendCommand(uint8_t command) {
+  sim_uartReceive(&command, 1);
+  for (uint8_t i = 0; i < 20; i++) {
+    sim_advanceMicros(LOOP_PERIOD_US);
+    runLoop();
+  }
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Replay
+//=====================================================================================================================================================
+static void replayTrace(const char* name, const TraceEvent* events, size_t count) {
+  memset(&report, 0, sizeof(report));
+  report.wireBytes = UART_TX_BUFFER_SIZE;
+
+  // The pins start at their recorded levels, long enough for the debouncer
+  TEST_ASSERT_EQUAL(TRACE_KIND_LEVELS, events[0].kind);
+  for (uint8_t pin = 0; pin < 8; pin++) {
+    if (INPUT_TRACE_PINS & (1 << pin)) {
+      sim_setPin(pin, (events[0].value & (1 << pin)) ? HIGH : LOW);
+    }
+  }
+  report.start = hal_micros();
+  runUntil(100000);
+
+  sendCommand('I');
+  TEST_ASSERT_TRUE(inputTrace_recording());
+  report.start = inputTrace_startTime();
+  report.endCount = 0;
+
+  uint8_t expectedEnds = 0;
+  uint16_t expectedTransitions = 0;
+  unsigned long lastTransition = 0;
+  unsigned long lastTime = 0;
+  for (size_t index = 1; index < count; index++) {
+    const TraceEvent& event = events[index];
+    if (event.kind == TRACE_KIND_PIN) {
+      runUntil(event.time);
+      sim_setPin(event.index, event.value);
+      // Pins changed at the same time are one transition of the port
+      if (expectedTransitions == 0 || event.time != lastTransition) {
+        expectedTransitions++;
+      }
+      lastTransition = event.time;
+    } else if (event.kind == TRACE_KIND_SCREEN) {
+      runUntil(event.time);
+      TEST_ASSERT_EQUAL_STRING(event.text, sim_lcdRow(event.index));
+    } else if (event.kind == TRACE_KIND_SEQUENCE_END) {
+      expectedEnds++;
+    }
+    if (event.time > lastTime) {
+      lastTime = event.time;
+    }
+  }
+  runUntil(lastTime + END_TOLERANCE_MS * 1000UL);
+  sendCommand('O');
+  for (uint8_t i = 0; i < 20 && !report.finished; i++) {
+    sim_advanceMicros(LOOP_PERIOD_US);
+    runLoop();
+  }
+
+  // Same verdicts as the box, at the same times
+  TEST_ASSERT_EQUAL(expectedEnds, report.endCount);
+  uint8_t end = 0;
+  for (size_t index = 1; index < count; index++) {
+    const TraceEvent& event = events[index];
+    if (event.kind != TRACE_KIND_SEQUENCE_END) {
+      continue;
+    }
+    const SequenceEnd& replayed = report.ends[end++];
+    TEST_ASSERT_EQUAL(event.index, replayed.sequence);
+    TEST_ASSERT_EQUAL(event.value, replayed.verdict);
+    TEST_ASSERT_UINT32_WITHIN(END_TOLERANCE_MS, event.time / 1000UL, replayed.time);
+    TEST_ASSERT_UINT32_WITHIN(END_TOLERANCE_MS, event.duration, replayed.duration);
+  }
+
+  // The recorder sees the transitions at the times they were replayed
+  TEST_ASSERT_TRUE(report.finished);
+  TEST_ASSERT_EQUAL(0, inputTrace_overflows());
+  TEST_ASSERT_EQUAL(expectedTransitions, report.transitionCount);
+  TEST_ASSERT_EQUAL(lastTransition, report.transitions[report.transitionCount - 1]);
+
+  printf("{\"replay\":\"%s\",\"events\":%lu,\"virtual_time_ms\":%lu,\"loops\":%lu,\"blocked_max_us\":%lu}\n", name,
+         (unsigned long)count, (hal_micros() - report.start) / 1000UL, report.loops, report.blockedMax);
+  TEST_ASSERT_EQUAL(0, report.blockedMax);
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Traces, add a test per file of traces/
+//=====================================================================================================================================================
+void test_desk_session() {
+  replayTrace("desk_session", DESK_SESSION, sizeof(DESK_SESSION) / sizeof(DESK_SESSION[0]));
+}
+//=====================================================================================================================================================
+
+
+
+//=====================================================================================================================================================
+// Bounce burst: every recorded input bounces at once, the recorder must keep all the transitions
+//=====================================================================================================================================================
+// The serial line drains the UART at its baud rate, so the transitions wait in the recorder's ring while the burst
+// lasts. The pins end at their levels before the burst.
+void test_bounce_burst_recorded() {
+  memset(&report, 0, sizeof(report));
+  report.wireBytes = UART_TX_BUFFER_SIZE;
+  sendCommand('I');
+  TEST_ASSERT_TRUE(inputTrace_recording());
+  report.start = inputTrace_startTime();
+  report.wireBytes = WIRE_BYTES_PER_LOOP;
+
+  const unsigned long edgePeriod = 5000UL / (INPUT_TRACE_PIN_COUNT * INPUT_TRACE_BOUNCE_EDGES);
+  uint16_t edges = 0;
+  unsigned long elapsed = 0;
+  for (uint8_t edge = 0; edge < INPUT_TRACE_BOUNCE_EDGES; edge++) {
+    for (uint8_t pin = 0; pin < 8; pin++) {
+      if (!(INPUT_TRACE_PINS & (1 << pin))) {
+        continue;
+      }
+      sim_advanceMicros(edgePeriod);
+      elapsed += edgePeriod;
+      sim_setPin(pin, sim_pin(pin) == HIGH ? LOW : HIGH);
+      edges++;
+      if (elapsed >= LOOP_PERIOD_US) {
+        elapsed -= LOOP_PERIOD_US;
+        runLoop();
+      }
+    }
+  }
+  sendCommand('O');
+  for (uint8_t i = 0; i < 100 && !report.finished; i++) {
+    sim_advanceMicros(LOOP_PERIOD_US);
+    runLoop();
+  }
+
+  TEST_ASSERT_EQUAL(INPUT_TRACE_PIN_COUNT * INPUT_TRACE_BOUNCE_EDGES, edges);
+  TEST_ASSERT_TRUE(report.finished);
+  TEST_ASSERT_EQUAL(0, inputTrace_overflows());
+  TEST_ASSERT_EQUAL(edges, report.transitionCount);
+}
+//=====================================================================================================================================================
+
+
+
+int main() {
+  sim_reset();
+  setup();
+  sim_enableBusTiming(true);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_desk_session);
+  RUN_TEST(test_bounce_burst_recorded);
+  return UNITY_END();
+}
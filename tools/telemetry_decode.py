@@ -0,0 +1,331 @@
+#!/usr/bin/env python3
+"""Decoder of the binary telemetry stream sent by the test box (see include/Telemetry.h).
+
+Reads the serial port of the box (pyserial) or a raw capture file and prints one JSON object per frame. With
+--archive, the objects are also appended to a JSON-lines file so the line PC keeps the history of every unit.
+
+    python3 tools/telemetry_decode.py --port /dev/ttyACM0 --archive results.jsonl
+    python3 tools/telemetry_decode.py --file capture.bin
+    python3 tools/telemetry_decode.py --port /dev/ttyACM0 --dump --archive journal.jsonl
+
+--dump asks the box to send its EEPROM result journal first (one record per test cycle), --trace the last 10 kHz
+capture of the shutdown request line.
+
+--send drives an automated run: each character is a remote-control command of the box (see src/main.cpp), sent in
+order before the stream is read. N confirms like the next button, K skips the current sequences, S1..S5 starts a
+sequence, P reports the pin levels and R the results of the running cycle; each answers with a frame. On a box that
+tests several machines, C1..C4 selects the machine the next commands act on; every frame about a sequence or a cycle
+tells its machine. W reports the share of time the box slept since the previous W, its duty cycle.
+
+    python3 tools/telemetry_decode.py --port /dev/ttyACM0 --send S1NNP
+    python3 tools/telemetry_decode.py --port /dev/ttyACM0 --send C2KP
+
+--record-inputs restarts the box at sequence 1 and writes every transition of its inputs (D2, D3, D5, D6, D7) to a
+trace file, with the verdicts the box gave, until the decoder is stopped. Copied into test/test_native_replay/traces
+and listed in its test_main.cpp, the trace is replayed into the native build and checked against those verdicts.
+
+    python3 tools/telemetry_decode.py --port /dev/ttyACM0 --record-inputs field_session.trace
+
+Opening the port resets an Arduino Uno through DTR, and its bootloader would swallow the bytes sent during the
+first second. With --dump, --trace, --send or --record-inputs the decoder therefore waits for the first frame of
+the box, the start of sequence 1 after the reset, before it sends its commands; a box that sends nothing within
+BOOT_TIMEOUT_S, not reset by the port, gets them anyway.
+"""
+import argparse
+import json
+import struct
+import sys
+import time
+
+SYNC = 0xA5
+BAUD_RATE = 115200
+MAX_PAYLOAD = 16
+SETTLE_NONE = 0xFFFFFFFF
+BOOT_TIMEOUT_S = 5                                # Bootloader and setup() of the box after the reset by DTR
+
+SEQUENCE_NAMES = ["EMERGENCY", "WALL_SWITCH_FEEDBACK", "START_SCANNER", "SHUTDOWN_REQUEST", "SHUTDOWN_COMMAND"]
+VERDICT_NAMES = ["OK", "NOK", "NO_SIGNAL", "CONFIRMED", "SKIPPED"]
+CHANNEL_NAMES = ["EMERGENCY", "WALL_SWITCH"]
+ROUND_TRIP_INPUT_NAMES = ["START", "SHUTDOWN_REQUEST"]
+ROUND_TRIP_BIN_LIMITS_MS = [1, 2, 4, 8, 16, 32, 64]
+COMMAND_DUMP_JOURNAL = b"D"
+COMMAND_SEND_TRACE = b"T"
+COMMAND_RECORD_INPUTS = b"I"
+COMMAND_STOP_RECORDING = b"O"
+STATUS_PINS = [2, 3, 5, 6, 7]
+JOURNAL_VERDICT_NONE = 7
+TIME_NONE = 0xFFFF
+CHANNEL_SHIFT = 5                                 # Channel of the machine in the sequence fields
+JOURNAL_BOUNCE_BITS = 3
+JOURNAL_CHANNEL_SHIFT = 6
+
+
+def crc16(data, crc=0xFFFF):
+    """CRC-16/CCITT-FALSE, same as telemetry_crc16()."""
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def name(names, index):
+    return names[index] if index < len(names) else index
+
+
+def sequence_field(field):
+    """Splits a sequence field: machine 1 is channel 0, on the Uno pins."""
+    return {"machine": (field >> CHANNEL_SHIFT) + 1,
+            "sequence": name(SEQUENCE_NAMES, field & ((1 << CHANNEL_SHIFT) - 1))}
+
+
+def decode_payload(frame_type, payload):
+    if frame_type == 0x01:
+        sequence, time_ms = struct.unpack("<BI", payload)
+        return dict({"frame": "sequence_start"}, **sequence_field(sequence), time_ms=time_ms)
+    if frame_type == 0x02:
+        sequence, verdict, time_ms, duration_ms, settle_ms = struct.unpack("<BBIII", payload)
+        return dict({"frame": "sequence_end"}, **sequence_field(sequence), verdict=name(VERDICT_NAMES, verdict),
+                    time_ms=time_ms, duration_ms=duration_ms, settle_ms=None if settle_ms == SETTLE_NONE else settle_ms)
+    if frame_type == 0x03:
+        channel, level, time_us = struct.unpack("<BBI", payload)
+        return {"frame": "edge", "channel": name(CHANNEL_NAMES, channel), "level": level, "time_us": time_us}
+    if frame_type == 0x04:
+        sequence, channel, edges, bounces, response_us, settle_us = struct.unpack("<BBBBII", payload)
+        return {"frame": "edge_stats", "sequence": name(SEQUENCE_NAMES, sequence), "channel": name(CHANNEL_NAMES, channel),
+                "edges": edges, "bounces": bounces, "response_us": response_us, "settle_us": settle_us}
+    if frame_type == 0x05:
+        input_index, latency_us = struct.unpack("<BI", payload)
+        return {"frame": "round_trip", "input": name(ROUND_TRIP_INPUT_NAMES, input_index), "latency_us": latency_us}
+    if frame_type == 0x06:
+        count, missed, min_us, mean_us, max_us = struct.unpack("<HHIII", payload)
+        return {"frame": "round_trip_stats", "count": count, "missed": missed, "min_us": min_us, "mean_us": mean_us,
+                "max_us": max_us}
+    if frame_type == 0x07:
+        counts = struct.unpack("<%dH" % (len(payload) // 2), payload)
+        labels = ["<%dms" % limit for limit in ROUND_TRIP_BIN_LIMITS_MS] + [">=%dms" % ROUND_TRIP_BIN_LIMITS_MS[-1]]
+        return {"frame": "round_trip_histogram", "bins": dict(zip(labels, counts))}
+    if frame_type in (0x08, 0x0D):
+        (run, verdicts, emergency_response, emergency_settle, wall_response, wall_settle, round_trip, bounces,
+         _checksum) = struct.unpack("<HHHHHHHBB", payload)
+        results = {}
+        for index, sequence in enumerate(SEQUENCE_NAMES):
+            verdict = (verdicts >> (3 * index)) & 7
+            if verdict != JOURNAL_VERDICT_NONE:
+                results[sequence] = name(VERDICT_NAMES, verdict)
+
+        def optional(value, scale=1):
+            return None if value == TIME_NONE else value * scale
+
+        bounce_mask = (1 << JOURNAL_BOUNCE_BITS) - 1
+        return {"frame": "journal_record" if frame_type == 0x08 else "cycle_record", "run": run,
+                "machine": (bounces >> JOURNAL_CHANNEL_SHIFT) + 1, "verdicts": results,
+                "emergency_response_ms": optional(emergency_response), "emergency_settle_us": optional(emergency_settle),
+                "emergency_bounces": bounces & bounce_mask, "wall_switch_response_ms": optional(wall_response),
+                "wall_switch_settle_us": optional(wall_settle),
+                "wall_switch_bounces": (bounces >> JOURNAL_BOUNCE_BITS) & bounce_mask,
+                "round_trip_ms": optional(round_trip, 0.1)}
+    if frame_type == 0x09:
+        (records,) = struct.unpack("<B", payload)
+        return {"frame": "journal_end", "records": records}
+    if frame_type == 0x0A:
+        edges, glitches, min_us, max_us, period_us, samples, trigger = struct.unpack("<BBIIHHH", payload)
+        return {"frame": "capture_stats", "edges": edges, "glitches": glitches, "min_width_us": min_us,
+                "max_width_us": max_us, "sample_period_us": period_us, "samples": samples, "trigger_sample": trigger}
+    if frame_type == 0x0B:
+        offset = payload[0]
+        # One character per sample, oldest first
+        levels = "".join("1" if byte & (1 << bit) else "0" for byte in payload[1:] for bit in range(8))
+        return {"frame": "capture_trace", "first_sample": offset * 8, "levels": levels}
+    if frame_type == 0x0C:
+        sequence, step, screen, levels, output, countdown = struct.unpack("<BBBBBH", payload)
+        return dict({"frame": "status"}, **sequence_field(sequence), step=step, screen=screen,
+                    inputs={"D%d" % pin: (levels >> pin) & 1 for pin in STATUS_PINS},
+                    shutdown_command=output, countdown_s=countdown)
+    if frame_type == 0x0E:
+        command, accepted, sequence = struct.unpack("<BBB", payload)
+        return dict({"frame": "command_ack", "command": chr(command), "accepted": bool(accepted)},
+                    **sequence_field(sequence))
+    if frame_type == 0x0F:
+        time_us, levels = struct.unpack("<IB", payload)
+        return {"frame": "input_trace_start", "time_us": time_us, "levels": levels}
+    if frame_type == 0x10:
+        time_us, levels = struct.unpack("<IB", payload)
+        return {"frame": "input_transition", "time_us": time_us, "levels": levels}
+    if frame_type == 0x11:
+        transitions, overflows = struct.unpack("<HB", payload)
+        return {"frame": "input_trace_end", "transitions": transitions, "lost": overflows}
+    if frame_type == 0x12:
+        window_ms, asleep_ms, wakeups, longest_sleep_us = struct.unpack("<IIIH", payload)
+        duty_cycle = 100.0 * (window_ms - asleep_ms) / window_ms if window_ms else 0.0
+        return {"frame": "power_stats", "window_ms": window_ms, "asleep_ms": asleep_ms,
+                "duty_cycle_percent": round(duty_cycle, 1), "wakeups": wakeups, "longest_sleep_us": longest_sleep_us}
+    return {"frame": "unknown", "type": frame_type, "payload": payload.hex()}
+
+
+class TraceWriter:
+    """Writes the input transitions of a recording as a trace file of the replay tests: one C macro per line, included
+    by test/test_native_replay/test_main.cpp. The verdicts given by the box during the recording become the expected
+    results of the replay."""
+
+    def __init__(self, path):
+        self.path = path
+        self.file = None
+        self.start_us = 0
+        self.levels = 0
+
+    def add(self, frame):
+        kind = frame["frame"]
+        if kind == "input_trace_start":
+            if self.file:
+                self.file.close()
+            self.file = open(self.path, "w")
+            self.start_us = frame["time_us"]
+            self.levels = frame["levels"]
+            self.file.write("// Input trace recorded by tools/telemetry_decode.py on %s\n" % time.strftime("%Y-%m-%d %H:%M"))
+            self.file.write("// TRACE_PIN(us since the start, pin, level), TRACE_SEQUENCE_END(ms since the start, sequence, "
+                            "verdict, duration ms)\n")
+            self.file.write("TRACE_LEVELS(0x%02X)\n" % self.levels)
+        elif not self.file:
+            return
+        elif kind == "input_transition":
+            changed = frame["levels"] ^ self.levels
+            for pin in STATUS_PINS:
+                if changed & (1 << pin):
+                    level = "HIGH" if frame["levels"] & (1 << pin) else "LOW"
+                    self.file.write("TRACE_PIN(%d, %d, %s)\n" % (frame["time_us"], pin, level))
+            self.levels = frame["levels"]
+        elif kind == "sequence_end" and frame["verdict"] != "SKIPPED" and frame["machine"] == 1:
+            # Only the Uno pins are recorded: the other machines are not in the trace
+            time_ms = (frame["time_ms"] * 1000 - self.start_us) % (1 << 32) // 1000
+            self.file.write("TRACE_SEQUENCE_END(%d, %d, VERDICT_%s, %d)\n" % (
+                time_ms, SEQUENCE_NAMES.index(frame["sequence"]), frame["verdict"], frame["duration_ms"]))
+        elif kind == "input_trace_end":
+            self.file.write("// %d transitions, %d lost\n" % (frame["transitions"], frame["lost"]))
+            if frame["lost"]:
+                print("%d input transitions lost, the trace cannot be replayed faithfully" % frame["lost"],
+                      file=sys.stderr)
+            self.close()
+
+    def close(self):
+        if self.file:
+            self.file.close()
+            self.file = None
+
+
+class Decoder:
+    """Incremental decoder: feed() any chunk of bytes, complete frames are returned. Corrupted frames are skipped by
+    searching the next sync byte."""
+
+    def __init__(self):
+        self.buffer = bytearray()
+        self.crc_errors = 0
+
+    def feed(self, data):
+        self.buffer.extend(data)
+        frames = []
+        while True:
+            start = self.buffer.find(bytes([SYNC]))
+            if start < 0:
+                self.buffer.clear()
+                return frames
+            del self.buffer[:start]
+            if len(self.buffer) < 3:
+                return frames
+            length = self.buffer[2]
+            if length > MAX_PAYLOAD:
+                del self.buffer[0]
+                continue
+            if len(self.buffer) < length + 5:
+                return frames
+            body = bytes(self.buffer[1:3 + length])
+            crc = self.buffer[3 + length] | (self.buffer[4 + length] << 8)
+            if crc != crc16(body):
+                self.crc_errors += 1
+                del self.buffer[0]
+                continue
+            try:
+                frames.append(decode_payload(body[0], body[2:]))
+            except struct.error:
+                frames.append({"frame": "malformed", "type": body[0], "payload": body[2:].hex()})
+            del self.buffer[:length + 5]
+
+
+def chunks(arguments):
+    if arguments.file:
+        with open(arguments.file, "rb") as capture:
+            yield capture.read()
+        return
+    import serial
+    with serial.Serial(arguments.port, BAUD_RATE, timeout=0.2) as port:
+        if arguments.dump or arguments.trace or arguments.send or arguments.record_inputs:
+            yield wait_for_boot(port)
+        if arguments.dump:
+            port.write(COMMAND_DUMP_JOURNAL)
+        if arguments.trace:
+            port.write(COMMAND_SEND_TRACE)
+        if arguments.send:
+            port.write(arguments.send.encode("ascii"))
+        if arguments.record_inputs:
+            port.write(COMMAND_RECORD_INPUTS)
+        try:
+            while True:
+                yield port.read(256)
+        finally:
+            if arguments.record_inputs:
+                port.write(COMMAND_STOP_RECORDING)
+
+
+def wait_for_boot(port):
+    """Reads until the first frame of the box, or BOOT_TIMEOUT_S, and returns the bytes read for the decoder"""
+    received = bytearray()
+    decoder = Decoder()
+    deadline = time.monotonic() + BOOT_TIMEOUT_S
+    while time.monotonic() < deadline:
+        chunk = port.read(256)
+        received.extend(chunk)
+        if decoder.feed(chunk):
+            break
+    return bytes(received)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("--port", help="serial port of the test box")
+    source.add_argument("--file", help="raw capture of the stream")
+    parser.add_argument("--archive", help="JSON-lines file the decoded frames are appended to")
+    parser.add_argument("--dump", action="store_true", help="request the EEPROM result journal (with --port)")
+    parser.add_argument("--trace", action="store_true", help="request the shutdown request trace (with --port)")
+    parser.add_argument("--send", help="remote-control commands sent to the box, e.g. S1NNP (with --port)")
+    parser.add_argument("--record-inputs", metavar="TRACE", help="record the input transitions to a trace file")
+    arguments = parser.parse_args()
+
+    decoder = Decoder()
+    archive = open(arguments.archive, "a") if arguments.archive else None
+    trace = TraceWriter(arguments.record_inputs) if arguments.record_inputs else None
+    try:
+        for chunk in chunks(arguments):
+            for frame in decoder.feed(chunk):
+                if trace:
+                    trace.add(frame)
+                frame["received"] = time.strftime("%Y-%m-%dT%H:%M:%S")
+                line = json.dumps(frame)
+                print(line)
+                if archive:
+                    archive.write(line + "\n")
+                    archive.flush()
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if archive:
+            archive.close()
+        if trace:
+            trace.close()
+    if decoder.crc_errors:
+        print("%d corrupted frames skipped" % decoder.crc_errors, file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()